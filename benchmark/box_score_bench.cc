@@ -0,0 +1,237 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Exactness and cost of the DB box score engines.
+//
+//   box_score_bench [boxes] [rounds]
+//
+// boxes:    BoxScorer against the fillPoly + cv::mean mask path, on
+//           rotated quads, axis-aligned rects and non-convex polygons
+//           over a synthetic probability map.
+// pipeline: DBPostProcess with score_engine "mask" and "integral" on the
+//           same map; box counts and scores must match.
+// Exits with 1 when a score differs by more than 1e-4.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "src/modules/text_detection/processors.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const double kTolerance = 1e-4;
+
+double Millis(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// DBPostProcess::BoxScoreFast: vertices truncated to pixels, fillPoly over
+// the bounding ROI and cv::mean under that mask.
+float MaskScore(const cv::Mat& pred, const std::vector<cv::Point2f>& polygon) {
+  int h = pred.rows;
+  int w = pred.cols;
+  float min_x = polygon[0].x, max_x = polygon[0].x;
+  float min_y = polygon[0].y, max_y = polygon[0].y;
+  for (const auto& point : polygon) {
+    min_x = std::min(min_x, point.x);
+    max_x = std::max(max_x, point.x);
+    min_y = std::min(min_y, point.y);
+    max_y = std::max(max_y, point.y);
+  }
+  int xmin = std::min(std::max(0, static_cast<int>(std::floor(min_x))), w - 1);
+  int xmax = std::min(std::max(0, static_cast<int>(std::ceil(max_x))), w - 1);
+  int ymin = std::min(std::max(0, static_cast<int>(std::floor(min_y))), h - 1);
+  int ymax = std::min(std::max(0, static_cast<int>(std::ceil(max_y))), h - 1);
+
+  cv::Mat mask = cv::Mat::zeros(ymax - ymin + 1, xmax - xmin + 1, CV_8UC1);
+  std::vector<cv::Point> points;
+  for (const auto& point : polygon) {
+    points.push_back(cv::Point(static_cast<int>(point.x - xmin),
+                               static_cast<int>(point.y - ymin)));
+  }
+  std::vector<std::vector<cv::Point>> contours = {points};
+  cv::fillPoly(mask, contours, cv::Scalar(1));
+  cv::Mat roi = pred(cv::Rect(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1));
+  return static_cast<float>(cv::mean(roi, mask)[0]);
+}
+
+// Text-line like blobs with soft edges over low noise.
+cv::Mat MakeMap(int rows, int cols, std::mt19937* rng) {
+  cv::Mat pred(rows, cols, CV_32FC1);
+  cv::randu(pred, cv::Scalar(0.0), cv::Scalar(0.2));
+  std::uniform_real_distribution<float> x(0.0f, cols);
+  std::uniform_real_distribution<float> y(0.0f, rows);
+  std::uniform_real_distribution<float> len(20.0f, 200.0f);
+  std::uniform_real_distribution<float> angle(-30.0f, 30.0f);
+  for (int i = 0; i < 300; ++i) {
+    cv::RotatedRect rect(cv::Point2f(x(*rng), y(*rng)),
+                         cv::Size2f(len(*rng), len(*rng) / 8 + 6),
+                         angle(*rng));
+    cv::Point2f corners[4];
+    rect.points(corners);
+    std::vector<cv::Point> points;
+    for (const auto& corner : corners) {
+      points.push_back(corner);
+    }
+    cv::fillConvexPoly(pred, points, cv::Scalar(0.9));
+  }
+  cv::GaussianBlur(pred, pred, cv::Size(5, 5), 0);
+  return pred;
+}
+
+std::vector<std::vector<cv::Point2f>> MakeQuads(const cv::Mat& pred,
+                                                size_t count,
+                                                std::mt19937* rng) {
+  // Centers stay on the map; corners may cross its border, as the min area
+  // rects of edge regions do.
+  std::uniform_real_distribution<float> x(0.0f, pred.cols - 1.0f);
+  std::uniform_real_distribution<float> y(0.0f, pred.rows - 1.0f);
+  std::uniform_real_distribution<float> len(2.0f, 160.0f);
+  std::uniform_real_distribution<float> angle(-45.0f, 45.0f);
+  std::vector<std::vector<cv::Point2f>> quads;
+  for (size_t i = 0; i < count; ++i) {
+    // Every fourth quad is axis-aligned, as most boxes of upright pages are.
+    float theta = i % 4 == 0 ? 0.0f : angle(*rng);
+    cv::RotatedRect rect(cv::Point2f(x(*rng), y(*rng)),
+                         cv::Size2f(len(*rng), len(*rng) / 4 + 1), theta);
+    cv::Point2f corners[4];
+    rect.points(corners);
+    DBPostProcess::OrderCorners(corners);
+    quads.push_back(std::vector<cv::Point2f>(corners, corners + 4));
+  }
+  return quads;
+}
+
+// Arrow shapes, non-convex like the polygons of box_type "poly".
+std::vector<std::vector<cv::Point2f>> MakePolygons(const cv::Mat& pred,
+                                                   size_t count,
+                                                   std::mt19937* rng) {
+  std::uniform_real_distribution<float> x(0.0f, pred.cols - 1.0f);
+  std::uniform_real_distribution<float> y(0.0f, pred.rows - 1.0f);
+  std::uniform_real_distribution<float> len(8.0f, 120.0f);
+  std::vector<std::vector<cv::Point2f>> polygons;
+  for (size_t i = 0; i < count; ++i) {
+    float x0 = x(*rng), y0 = y(*rng), w = len(*rng), h = len(*rng) / 3 + 4;
+    polygons.push_back({cv::Point2f(x0, y0), cv::Point2f(x0 + w, y0),
+                        cv::Point2f(x0 + w / 2, y0 + h / 2),
+                        cv::Point2f(x0 + w, y0 + h), cv::Point2f(x0, y0 + h)});
+  }
+  return polygons;
+}
+
+bool CompareBoxes(const std::string& name, const cv::Mat& pred,
+                  const std::vector<std::vector<cv::Point2f>>& polygons,
+                  bool convex, int rounds) {
+  std::vector<float> mask(polygons.size());
+  auto start = Clock::now();
+  for (int r = 0; r < rounds; ++r) {
+    for (size_t i = 0; i < polygons.size(); ++i) {
+      mask[i] = MaskScore(pred, polygons[i]);
+    }
+  }
+  double mask_ms = Millis(Clock::now() - start) / rounds;
+
+  std::vector<float> integral;
+  start = Clock::now();
+  for (int r = 0; r < rounds; ++r) {
+    BoxScorer scorer(pred);
+    integral = scorer.PolygonMeans(polygons, convex);
+  }
+  double integral_ms = Millis(Clock::now() - start) / rounds;
+
+  double max_diff = 0.0, sum_diff = 0.0;
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    double diff = std::abs(mask[i] - integral[i]);
+    max_diff = std::max(max_diff, diff);
+    sum_diff += diff;
+  }
+  std::printf(
+      "  %-10s %6zu boxes  max diff %.2e  mean diff %.2e  mask %8.3f ms  "
+      "integral %8.3f ms\n",
+      name.c_str(), polygons.size(), max_diff, sum_diff / polygons.size(),
+      mask_ms, integral_ms);
+  return max_diff <= kTolerance;
+}
+
+bool ComparePipeline(const cv::Mat& pred, int rounds) {
+  // Apply takes NCHW maps.
+  int sizes[] = {1, 1, pred.rows, pred.cols};
+  cv::Mat preds(4, sizes, CV_32FC1, pred.data);
+  std::vector<int> img_shapes = {pred.rows, pred.cols};
+  std::vector<std::pair<BoxStore, std::vector<float>>> results[2];
+  double millis[2] = {0.0, 0.0};
+  const char* engines[] = {"mask", "integral"};
+  for (int e = 0; e < 2; ++e) {
+    DBPostProcess post_op(0.3f, 0.6f, 1000, 1.5f);
+    if (!post_op.SetScoreEngine(engines[e]).ok()) {
+      return false;
+    }
+    auto start = Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+      auto result = post_op.Apply(preds, img_shapes);
+      if (!result.ok()) {
+        std::printf("  %s: %s\n", engines[e],
+                    result.status().ToString().c_str());
+        return false;
+      }
+      results[e] = std::move(result.value());
+    }
+    millis[e] = Millis(Clock::now() - start) / rounds;
+  }
+  const auto& mask_scores = results[0][0].second;
+  const auto& integral_scores = results[1][0].second;
+  double max_diff = 0.0;
+  bool same = mask_scores.size() == integral_scores.size();
+  for (size_t i = 0; same && i < mask_scores.size(); ++i) {
+    max_diff = std::max<double>(
+        max_diff, std::abs(mask_scores[i] - integral_scores[i]));
+  }
+  std::printf(
+      "  %-10s %zu / %zu boxes  max diff %.2e  mask %8.3f ms  integral "
+      "%8.3f ms\n",
+      "pipeline", mask_scores.size(), integral_scores.size(), max_diff,
+      millis[0], millis[1]);
+  return same && max_diff <= kTolerance;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t boxes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+  boxes = std::max<size_t>(boxes, 1);
+  rounds = std::max(rounds, 1);
+
+  std::mt19937 rng(2025);
+  cv::Mat pred = MakeMap(960, 1280, &rng);
+  bool ok = true;
+  std::printf("960x1280 map, %d rounds\n", rounds);
+  ok &= CompareBoxes("quads", pred, MakeQuads(pred, boxes, &rng), true,
+                     rounds);
+  ok &= CompareBoxes("polygons", pred, MakePolygons(pred, boxes, &rng), false,
+                     rounds);
+  ok &= ComparePipeline(pred, rounds);
+  std::printf("%s\n", ok ? "OK" : "MISMATCH");
+  return ok ? 0 : 1;
+}
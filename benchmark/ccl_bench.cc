@@ -0,0 +1,235 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// DBPostProcess::LabelComponents against a BFS reference, and its cost.
+//
+//   ccl_bench [masks] [rounds]
+//
+// check: `masks` random masks of random size and density, half of them
+//        with a small max_candidates. Each component must match the BFS
+//        component of its first pixel in area and score sum, its hull
+//        points must all lie in it, the kept ones must be the largest and
+//        come in raster order.
+// time:  labeling against findContours, the contour extractor's first
+//        step, on a text-like 1536x2048 map.
+// Exits with 1 on the first mismatch.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "src/modules/text_detection/processors.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Millis(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// 8-connected labels of `mask`, -1 off the mask, with area and score sum
+// per label.
+struct Reference {
+  std::vector<int> labels;
+  std::vector<size_t> areas;
+  std::vector<double> score_sums;
+};
+
+Reference LabelBfs(const cv::Mat& pred, const cv::Mat& mask) {
+  Reference ref;
+  ref.labels.assign(mask.total(), -1);
+  std::vector<int> queue;
+  for (int start = 0; start < static_cast<int>(mask.total()); ++start) {
+    if (mask.data[start] == 0 || ref.labels[start] >= 0) {
+      continue;
+    }
+    int label = static_cast<int>(ref.areas.size());
+    ref.areas.push_back(0);
+    ref.score_sums.push_back(0.0);
+    queue.assign(1, start);
+    ref.labels[start] = label;
+    for (size_t head = 0; head < queue.size(); ++head) {
+      int y = queue[head] / mask.cols;
+      int x = queue[head] % mask.cols;
+      ref.areas[label]++;
+      ref.score_sums[label] += pred.at<float>(y, x);
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          int ny = y + dy, nx = x + dx;
+          if (ny < 0 || ny >= mask.rows || nx < 0 || nx >= mask.cols) {
+            continue;
+          }
+          int next = ny * mask.cols + nx;
+          if (mask.data[next] != 0 && ref.labels[next] < 0) {
+            ref.labels[next] = label;
+            queue.push_back(next);
+          }
+        }
+      }
+    }
+  }
+  return ref;
+}
+
+bool Check(const cv::Mat& pred, const cv::Mat& mask, int max_candidates) {
+  DBPostProcess post_op(0.3f, 0.7f, max_candidates);
+  auto components = post_op.LabelComponents(pred, mask);
+  Reference ref = LabelBfs(pred, mask);
+
+  size_t expected = ref.areas.size();
+  if (max_candidates >= 0) {
+    expected = std::min(expected, static_cast<size_t>(max_candidates));
+  }
+  if (components.size() != expected) {
+    std::printf("  %zu components, BFS keeps %zu\n", components.size(),
+                expected);
+    return false;
+  }
+  std::vector<bool> kept(ref.areas.size(), false);
+  size_t min_kept_area = mask.total();
+  int last_start = -1;
+  for (const auto& component : components) {
+    if (component.hull_points.empty()) {
+      std::printf("  component without hull points\n");
+      return false;
+    }
+    // Hull points follow the runs, so the first is the first pixel.
+    const cv::Point2f& first = component.hull_points[0];
+    int start = static_cast<int>(first.y) * mask.cols +
+                static_cast<int>(first.x);
+    int label = ref.labels[start];
+    if (label < 0 || kept[label] || start <= last_start) {
+      std::printf("  component at (%d, %d) out of place\n",
+                  static_cast<int>(first.x), static_cast<int>(first.y));
+      return false;
+    }
+    kept[label] = true;
+    last_start = start;
+    if (component.area != ref.areas[label] ||
+        std::abs(component.score_sum - ref.score_sums[label]) >
+            1e-6 * std::max(1.0, ref.score_sums[label])) {
+      std::printf("  area %zu / %zu, score sum %f / %f\n", component.area,
+                  ref.areas[label], component.score_sum,
+                  ref.score_sums[label]);
+      return false;
+    }
+    for (const auto& point : component.hull_points) {
+      int at = static_cast<int>(point.y) * mask.cols +
+               static_cast<int>(point.x);
+      if (ref.labels[at] != label) {
+        std::printf("  hull point outside its component\n");
+        return false;
+      }
+    }
+    min_kept_area = std::min(min_kept_area, component.area);
+  }
+  for (size_t label = 0; label < ref.areas.size(); ++label) {
+    if (!kept[label] && ref.areas[label] > min_kept_area) {
+      std::printf("  dropped a component of %zu pixels, kept one of %zu\n",
+                  ref.areas[label], min_kept_area);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CheckRandom(int masks, std::mt19937* rng) {
+  for (int i = 0; i < masks; ++i) {
+    int rows = 1 + (*rng)() % 64;
+    int cols = 1 + (*rng)() % 64;
+    int density = (*rng)() % 100;
+    cv::Mat pred(rows, cols, CV_32FC1);
+    cv::randu(pred, cv::Scalar(0.0), cv::Scalar(1.0));
+    cv::Mat mask(rows, cols, CV_8UC1);
+    for (size_t k = 0; k < mask.total(); ++k) {
+      mask.data[k] = static_cast<int>((*rng)() % 100) < density ? 1 : 0;
+    }
+    int max_candidates = i % 2 == 0 ? 1 + (*rng)() % 4 : 1000;
+    if (!Check(pred, mask, max_candidates)) {
+      std::printf("  mask %d: %dx%d, density %d%%\n", i, rows, cols,
+                  density);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Time(int rounds, std::mt19937* rng) {
+  cv::Mat pred(1536, 2048, CV_32FC1, cv::Scalar(0.05));
+  std::uniform_real_distribution<float> x(0.0f, 2048.0f);
+  std::uniform_real_distribution<float> y(0.0f, 1536.0f);
+  std::uniform_real_distribution<float> len(16.0f, 300.0f);
+  for (int i = 0; i < 1500; ++i) {
+    float w = len(*rng);
+    cv::RotatedRect rect(cv::Point2f(x(*rng), y(*rng)),
+                         cv::Size2f(w, w / 8 + 6), 0.0f);
+    cv::Point2f corners[4];
+    rect.points(corners);
+    std::vector<cv::Point> points(corners, corners + 4);
+    cv::fillConvexPoly(pred, points, cv::Scalar(0.9));
+  }
+  cv::Mat mask = pred > 0.3f;
+  mask /= 255;
+  if (!Check(pred, mask, 1000)) {
+    std::printf("  text-like map mismatch\n");
+    return false;
+  }
+  DBPostProcess post_op;
+
+  auto start = Clock::now();
+  size_t components = 0;
+  for (int r = 0; r < rounds; ++r) {
+    components = post_op.LabelComponents(pred, mask).size();
+  }
+  double label_ms = Millis(Clock::now() - start) / rounds;
+
+  start = Clock::now();
+  size_t contours_found = 0;
+  for (int r = 0; r < rounds; ++r) {
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(mask, contours, cv::RETR_LIST,
+                     cv::CHAIN_APPROX_SIMPLE);
+    contours_found = contours.size();
+  }
+  double contour_ms = Millis(Clock::now() - start) / rounds;
+  std::printf(
+      "  1536x2048: LabelComponents %8.3f ms (%zu components)  "
+      "findContours %8.3f ms (%zu contours)\n",
+      label_ms, components, contour_ms, contours_found);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int masks = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+  masks = std::max(masks, 1);
+  rounds = std::max(rounds, 1);
+
+  std::mt19937 rng(2025);
+  std::printf("check: %d random masks\n", masks);
+  bool ok = CheckRandom(masks, &rng);
+  std::printf("time: %d rounds\n", rounds);
+  ok &= Time(rounds, &rng);
+  std::printf("%s\n", ok ? "OK" : "MISMATCH");
+  return ok ? 0 : 1;
+}
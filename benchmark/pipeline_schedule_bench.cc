@@ -0,0 +1,222 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Scheduling of AutoParallelSimpleInferencePipeline on fake pipelines.
+//
+//   pipeline_schedule_bench [instances] [inputs]
+//
+// Fake pipelines sleep per input and answer with its index.
+// steal:   `inputs` single inputs through PredictAsync, every tenth one 25x
+//          slower, against the ideal of the total cost spread evenly.
+// chunked: PredictChunked on 0, 1, 3, 10 and `inputs` inputs, every
+//          seventh one 20x slower, in groups of 1 and 4; results must be
+//          complete and in order, and no group may be split.
+// Exits with 1 on a missing or misplaced result. Build it with
+// -fsanitize=thread to check the scheduler for races.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/common/parallel.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Millis(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+class FakeResult : public BaseCVResult {
+ public:
+  explicit FakeResult(int index) : index_(index){};
+
+  void SaveToImg(const std::string&) override{};
+  void Print() const override{};
+  void SaveToJson(const std::string&) const override{};
+
+  int Index() const { return index_; };
+
+ private:
+  int index_;
+};
+
+struct FakeParams {
+  // Every `slow_every`th input takes `slow_ms` instead of `fast_ms`.
+  int slow_every = 10;
+  int fast_ms = 2;
+  int slow_ms = 50;
+  // Pipeline calls must start on a multiple of this.
+  int group_size = 1;
+};
+
+std::atomic<int> split_groups(0);
+
+int CostMs(const FakeParams& params, int index) {
+  return index % params.slow_every == 0 ? params.slow_ms : params.fast_ms;
+}
+
+class FakePipeline : public BasePipeline {
+ public:
+  FakePipeline(const std::string& model_dir, const FakeParams& params)
+      : BasePipeline(model_dir), params_(params){};
+
+  std::vector<std::unique_ptr<BaseCVResult>> Predict(
+      const std::vector<std::string>& input) override {
+    std::vector<std::unique_ptr<BaseCVResult>> results;
+    if (!input.empty() && std::stoi(input[0]) % params_.group_size != 0) {
+      split_groups++;
+    }
+    for (const auto& item : input) {
+      int index = std::stoi(item);
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(CostMs(params_, index)));
+      results.emplace_back(new FakeResult(index));
+    }
+    return results;
+  };
+
+ private:
+  FakeParams params_;
+};
+
+using FakeParallel =
+    AutoParallelSimpleInferencePipeline<FakePipeline, FakeParams,
+                                        std::vector<std::string>,
+                                        std::vector<std::unique_ptr<
+                                            BaseCVResult>>>;
+
+// As OCRPipeline, Predict dispatches chunks over the instances.
+class FakeParallelPipeline : public FakeParallel {
+ public:
+  FakeParallelPipeline(const FakeParams& params, int instances)
+      : FakeParallel("fake", params, instances),
+        group_size_(params.group_size){};
+
+  std::vector<std::unique_ptr<BaseCVResult>> Predict(
+      const std::vector<std::string>& input) override {
+    return PredictChunked(input, group_size_);
+  };
+
+ private:
+  size_t group_size_;
+};
+
+// Results must hold indices first, first + 1, ... in order.
+bool InOrder(const std::vector<std::unique_ptr<BaseCVResult>>& results,
+             int first, int count) {
+  if (results.size() != static_cast<size_t>(count)) {
+    return false;
+  }
+  for (int i = 0; i < count; ++i) {
+    auto result = dynamic_cast<const FakeResult*>(results[i].get());
+    if (result == nullptr || result->Index() != first + i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double IdealMs(const FakeParams& params, int inputs, int instances) {
+  double total = 0.0;
+  double longest = 0.0;
+  for (int i = 0; i < inputs; ++i) {
+    total += CostMs(params, i);
+    longest = std::max<double>(longest, CostMs(params, i));
+  }
+  return std::max(total / instances, longest);
+}
+
+bool Steal(int instances, int inputs) {
+  FakeParams params;
+  params.slow_every = 10;
+  params.fast_ms = 2;
+  params.slow_ms = 50;
+  FakeParallelPipeline pipeline(params, instances);
+  auto start = Clock::now();
+  std::vector<std::future<std::vector<std::unique_ptr<BaseCVResult>>>>
+      futures;
+  for (int i = 0; i < inputs; ++i) {
+    futures.push_back(
+        pipeline.PredictAsync(std::vector<std::string>{std::to_string(i)}));
+  }
+  int wrong = 0;
+  for (int i = 0; i < inputs; ++i) {
+    if (!InOrder(futures[i].get(), i, 1)) {
+      wrong++;
+    }
+  }
+  std::printf("  steal    %4d inputs  wall %7.1f ms  ideal %7.1f ms  "
+              "%zu stolen\n",
+              inputs, Millis(Clock::now() - start),
+              IdealMs(params, inputs, instances), pipeline.StealCount());
+  if (wrong > 0) {
+    std::printf("  %d wrong results\n", wrong);
+  }
+  return wrong == 0;
+}
+
+bool Chunked(int instances, int inputs, int group_size) {
+  FakeParams params;
+  params.slow_every = 7;
+  params.fast_ms = 2;
+  params.slow_ms = 40;
+  params.group_size = group_size;
+  FakeParallelPipeline pipeline(params, instances);
+  split_groups = 0;
+  bool ok = true;
+  for (int n : {0, 1, 3, 10, inputs}) {
+    std::vector<std::string> items;
+    for (int i = 0; i < n; ++i) {
+      items.push_back(std::to_string(i));
+    }
+    auto start = Clock::now();
+    auto results = pipeline.Predict(items);
+    bool in_order = InOrder(results, 0, n);
+    std::printf(
+        "  chunked  %4d inputs  groups of %d  wall %7.1f ms  ideal %7.1f ms  "
+        "%s\n",
+        n, group_size, Millis(Clock::now() - start),
+        IdealMs(params, n, instances), in_order ? "in order" : "WRONG");
+    ok &= in_order;
+  }
+  if (split_groups > 0) {
+    std::printf("  %d calls started inside a group\n", split_groups.load());
+    return false;
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int instances = argc > 1 ? std::atoi(argv[1]) : 4;
+  int inputs = argc > 2 ? std::atoi(argv[2]) : 200;
+  instances = std::max(instances, 1);
+  inputs = std::max(inputs, 1);
+  std::printf("%d instances\n", instances);
+  bool ok = Steal(instances, inputs);
+  ok &= Chunked(instances, inputs, 1);
+  ok &= Chunked(instances, inputs, 4);
+  std::printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RecognitionService on fake recognizers.
+//
+//   recognition_service_bench [callers] [requests] [contexts]
+//
+// `callers` threads each submit `requests` requests of 1 to 8 quads on two
+// pages and wait for them. The fake recognizer costs a fixed launch plus
+// the padded batch width, and answers with the page and quad it was given,
+// so every caller checks that its results are its own and in order.
+// Reported per max_wait_us: request latency, batch sizes and throughput.
+// Exits with 1 on a wrong result or a batch beyond the planner's limits.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "src/modules/text_recogntion/recognition_service.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int kSlotStep = 32;
+const int kLaunchUs = 300;
+const int kColumnsPerUs = 64;
+
+struct BatchStats {
+  std::atomic<int> batches{0};
+  std::atomic<int> quads{0};
+  std::atomic<int> max_quads{0};
+  std::atomic<int> oversized{0};
+};
+
+// Quad i of a request spans x 0..width with y = i; pages hold their tag in
+// their only pixel.
+class FakeRecognizer : public QuadRecognizer {
+ public:
+  FakeRecognizer(const RecognitionService::Options& options,
+                 BatchStats* stats)
+      : options_(options), stats_(stats){};
+
+  int SlotWidth(const BoxView& quad) const override {
+    int width = static_cast<int>(quad[1].x - quad[0].x);
+    return (width + kSlotStep - 1) / kSlotStep * kSlotStep;
+  };
+
+  std::vector<TextRecPredictorResult> PredictQuads(
+      const std::vector<cv::Mat>& pages, const std::vector<int>& page_ids,
+      const BoxStore& quads, const std::vector<int>& angles) override {
+    int slot = 0;
+    for (const auto& quad : quads) {
+      slot = std::max(slot, SlotWidth(quad));
+    }
+    int count = static_cast<int>(quads.size());
+    std::this_thread::sleep_for(std::chrono::microseconds(
+        kLaunchUs + count * slot / kColumnsPerUs));
+
+    stats_->batches++;
+    stats_->quads += count;
+    int max_quads = stats_->max_quads.load();
+    while (count > max_quads &&
+           !stats_->max_quads.compare_exchange_weak(max_quads, count)) {
+    }
+    if (count > options_.max_batch ||
+        (options_.width_budget > 0 && count > 1 &&
+         count * slot > options_.width_budget)) {
+      stats_->oversized++;
+    }
+
+    std::vector<TextRecPredictorResult> results(quads.size());
+    for (size_t i = 0; i < quads.size(); ++i) {
+      results[i].rec_text = Expected(pages[page_ids[i]].at<int>(0, 0),
+                                     static_cast<int>(quads[i][0].y));
+      results[i].rec_score = static_cast<float>(angles[i]);
+    }
+    return results;
+  };
+
+  static std::string Expected(int page_tag, int quad) {
+    return std::to_string(page_tag) + ":" + std::to_string(quad);
+  };
+
+ private:
+  RecognitionService::Options options_;
+  BatchStats* stats_;
+};
+
+bool Run(int callers, int requests, int contexts, int max_wait_us) {
+  RecognitionService::Options options;
+  options.contexts = contexts;
+  options.max_wait_us = max_wait_us;
+  options.max_batch = 16;
+  options.width_budget = 16 * 640;
+  options.max_padding = 0.6f;
+  BatchStats stats;
+  std::vector<std::unique_ptr<QuadRecognizer>> recognizers;
+  for (int i = 0; i < contexts; ++i) {
+    recognizers.push_back(std::unique_ptr<QuadRecognizer>(
+        new FakeRecognizer(options, &stats)));
+  }
+  std::unique_ptr<RecognitionService> service(
+      new RecognitionService(std::move(recognizers), options));
+
+  std::atomic<int> wrong(0);
+  std::vector<std::vector<double>> latencies(callers);
+  std::vector<std::thread> threads;
+  auto start = Clock::now();
+  for (int t = 0; t < callers; ++t) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 rng(t);
+      for (int r = 0; r < requests; ++r) {
+        std::vector<cv::Mat> pages;
+        for (int p = 0; p < 2; ++p) {
+          pages.push_back(cv::Mat(1, 1, CV_32SC1,
+                                  cv::Scalar((t * requests + r) * 2 + p)));
+        }
+        int n = 1 + rng() % 8;
+        BoxStore quads;
+        std::vector<int> page_ids, angles;
+        for (int i = 0; i < n; ++i) {
+          float width = static_cast<float>(32 + rng() % 900);
+          cv::Point2f quad[4] = {cv::Point2f(0, i), cv::Point2f(width, i),
+                                 cv::Point2f(width, i + 1),
+                                 cv::Point2f(0, i + 1)};
+          quads.Add(quad, 4);
+          page_ids.push_back(i % 2);
+          angles.push_back(rng() % 2);
+        }
+        auto submitted = Clock::now();
+        auto results = service->Submit(pages, page_ids, quads, angles).get();
+        latencies[t].push_back(
+            std::chrono::duration<double, std::micro>(Clock::now() -
+                                                      submitted)
+                .count());
+        if (results.size() != static_cast<size_t>(n)) {
+          wrong++;
+          continue;
+        }
+        for (int i = 0; i < n; ++i) {
+          int tag = pages[page_ids[i]].at<int>(0, 0);
+          if (results[i].rec_text != FakeRecognizer::Expected(tag, i) ||
+              results[i].rec_score != angles[i]) {
+            wrong++;
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  service.reset();
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<double> all;
+  for (const auto& caller : latencies) {
+    all.insert(all.end(), caller.begin(), caller.end());
+  }
+  std::sort(all.begin(), all.end());
+  size_t n = all.size();
+  std::printf(
+      "  wait %5d us  p50 %8.1f us  p99 %8.1f us  %6.0f req/s  batches %d  "
+      "mean %.2f  max %d quads\n",
+      max_wait_us, all[n / 2], all[std::min(n - 1, n * 99 / 100)],
+      n / seconds, stats.batches.load(),
+      static_cast<double>(stats.quads) / std::max(stats.batches.load(), 1),
+      stats.max_quads.load());
+  if (wrong > 0 || stats.oversized > 0) {
+    std::printf("  %d wrong results, %d oversized batches\n", wrong.load(),
+                stats.oversized.load());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int callers = argc > 1 ? std::atoi(argv[1]) : 8;
+  int requests = argc > 2 ? std::atoi(argv[2]) : 200;
+  int contexts = argc > 3 ? std::atoi(argv[3]) : 2;
+  callers = std::max(callers, 1);
+  requests = std::max(requests, 1);
+  contexts = std::max(contexts, 1);
+  std::printf("%d callers, %d requests each, %d contexts\n", callers,
+              requests, contexts);
+  bool ok = true;
+  for (int max_wait_us : {0, 500, 2000}) {
+    ok &= Run(callers, requests, contexts, max_wait_us);
+  }
+  std::printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Submit/complete latency of the on-demand and the fixed ThreadPool mode.
+//
+//   thread_pool_bench [threads] [tasks]
+//
+// roundtrip: one task at a time, submit until its future is ready.
+// burst:     `tasks` tasks posted at once, until the last one has run.
+// idle gap:  like roundtrip, but after the pool sat idle for longer than
+//            the on-demand workers live, as between two requests.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/common/thread_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Micros(Clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void Report(const std::string& name, std::vector<double>* samples) {
+  std::sort(samples->begin(), samples->end());
+  size_t n = samples->size();
+  double sum = 0;
+  for (double sample : *samples) {
+    sum += sample;
+  }
+  std::printf("  %-10s mean %9.2f us  p50 %9.2f us  p99 %9.2f us\n",
+              name.c_str(), sum / n, (*samples)[n / 2],
+              (*samples)[std::min(n - 1, n * 99 / 100)]);
+}
+
+void Roundtrip(PaddlePool::ThreadPool* pool, int rounds) {
+  std::vector<double> samples;
+  for (int i = 0; i < rounds; ++i) {
+    auto start = Clock::now();
+    pool->submit([i]() { return i; }).get();
+    samples.push_back(Micros(Clock::now() - start));
+  }
+  Report("roundtrip", &samples);
+}
+
+void Burst(PaddlePool::ThreadPool* pool, int tasks, int rounds) {
+  std::vector<double> samples;
+  for (int r = 0; r < rounds; ++r) {
+    std::atomic<int> left(tasks);
+    std::atomic<bool> done(false);
+    auto start = Clock::now();
+    for (int i = 0; i < tasks; ++i) {
+      pool->post([&left, &done]() {
+        if (left.fetch_sub(1) == 1) {
+          done.store(true);
+        }
+      });
+    }
+    while (!done.load()) {
+      std::this_thread::yield();
+    }
+    samples.push_back(Micros(Clock::now() - start) / tasks);
+  }
+  Report("burst/task", &samples);
+}
+
+void IdleGap(PaddlePool::ThreadPool* pool, int rounds) {
+  std::vector<double> samples;
+  for (int i = 0; i < rounds; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+    auto start = Clock::now();
+    pool->submit([i]() { return i; }).get();
+    samples.push_back(Micros(Clock::now() - start));
+  }
+  Report("idle gap", &samples);
+}
+
+void Run(const std::string& name, PaddlePool::ThreadPool* pool, int tasks) {
+  std::printf("%s\n", name.c_str());
+  // Lets the on-demand pool start its workers before it is measured.
+  Burst(pool, tasks, 3);
+  Roundtrip(pool, 20000);
+  Burst(pool, tasks, 200);
+  IdleGap(pool, 3);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                            : std::thread::hardware_concurrency();
+  int tasks = argc > 2 ? std::atoi(argv[2]) : 10000;
+  threads = std::max<size_t>(threads, 1);
+  tasks = std::max(tasks, 1);
+  std::printf("%zu threads, %d tasks per burst\n", threads, tasks);
+  {
+    PaddlePool::ThreadPool pool(threads);
+    Run("on demand", &pool, tasks);
+  }
+  {
+    PaddlePool::ThreadPool::Options options;
+    options.fixed = true;
+    PaddlePool::ThreadPool pool(threads, options);
+    Run("fixed", &pool, tasks);
+  }
+  {
+    PaddlePool::ThreadPool::Options options;
+    options.fixed = true;
+    for (size_t i = 0; i < threads; ++i) {
+      options.cpus.push_back(
+          static_cast<int>(i % std::thread::hardware_concurrency()));
+    }
+    PaddlePool::ThreadPool pool(threads, options);
+    Run("fixed+pin", &pool, tasks);
+  }
+  return 0;
+}
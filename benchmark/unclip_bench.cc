@@ -0,0 +1,166 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Agreement and cost of the DB quad unclip engines.
+//
+//   unclip_bench [regions] [rounds]
+//
+// Runs DBPostProcess with unclip_engine "clipper" and "analytic" on a
+// synthetic map of rotated text lines, per unclip ratio. Each analytic box
+// is matched to the clipper box with the nearest center; the report gives
+// the largest and mean corner distance of matched boxes and how many boxes
+// only one engine kept. Clipper works on truncated coordinates, so about a
+// pixel of difference is expected. Exits with 1 above 2 px, or when more
+// than 1% of the boxes are kept by only one engine.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "src/modules/text_detection/processors.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const double kMaxCornerDiff = 2.0;
+const double kMaxUnmatched = 0.01;
+
+double Millis(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Separate rotated text lines, so most regions reach the unclip step as
+// rectangles.
+cv::Mat MakeMap(int rows, int cols, int regions, std::mt19937* rng) {
+  cv::Mat pred = cv::Mat::zeros(rows, cols, CV_32FC1);
+  std::uniform_real_distribution<float> len(12.0f, 240.0f);
+  std::uniform_real_distribution<float> angle(-40.0f, 40.0f);
+  int grid = static_cast<int>(std::ceil(std::sqrt(regions)));
+  float cell_w = static_cast<float>(cols) / grid;
+  float cell_h = static_cast<float>(rows) / grid;
+  for (int i = 0; i < regions; ++i) {
+    cv::Point2f center((i % grid + 0.5f) * cell_w, (i / grid + 0.5f) * cell_h);
+    float w = std::min(len(*rng), cell_w * 0.6f);
+    float h = std::min(w / 6 + 4, cell_h * 0.3f);
+    cv::RotatedRect rect(center, cv::Size2f(w, h), angle(*rng));
+    cv::Point2f corners[4];
+    rect.points(corners);
+    std::vector<cv::Point> points(corners, corners + 4);
+    cv::fillConvexPoly(pred, points, cv::Scalar(0.95));
+  }
+  return pred;
+}
+
+cv::Point2f Center(const BoxView& box) {
+  cv::Point2f sum(0.0f, 0.0f);
+  for (const auto& point : box) {
+    sum += point;
+  }
+  return sum * (1.0f / box.size());
+}
+
+bool Compare(const cv::Mat& pred, float unclip_ratio, int rounds) {
+  int sizes[] = {1, 1, pred.rows, pred.cols};
+  cv::Mat preds(4, sizes, CV_32FC1, pred.data);
+  std::vector<int> img_shapes = {pred.rows, pred.cols};
+  BoxStore boxes[2];
+  double millis[2] = {0.0, 0.0};
+  const char* engines[] = {"clipper", "analytic"};
+  for (int e = 0; e < 2; ++e) {
+    DBPostProcess post_op(0.3f, 0.6f, 100000, unclip_ratio);
+    if (!post_op.SetUnclipEngine(engines[e]).ok()) {
+      return false;
+    }
+    auto start = Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+      auto result = post_op.Apply(preds, img_shapes);
+      if (!result.ok()) {
+        std::printf("  %s: %s\n", engines[e],
+                    result.status().ToString().c_str());
+        return false;
+      }
+      boxes[e] = std::move(result.value()[0].first);
+    }
+    millis[e] = Millis(Clock::now() - start) / rounds;
+  }
+
+  std::vector<cv::Point2f> clipper_centers;
+  for (const auto& box : boxes[0]) {
+    clipper_centers.push_back(Center(box));
+  }
+  std::vector<bool> matched(clipper_centers.size(), false);
+  size_t pairs = 0;
+  double max_diff = 0.0, sum_diff = 0.0;
+  for (const auto& box : boxes[1]) {
+    cv::Point2f center = Center(box);
+    size_t best = clipper_centers.size();
+    double best_dist = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < clipper_centers.size(); ++i) {
+      double dist = cv::norm(clipper_centers[i] - center);
+      if (!matched[i] && dist < best_dist) {
+        best = i;
+        best_dist = dist;
+      }
+    }
+    if (best == clipper_centers.size() || best_dist > kMaxCornerDiff * 2) {
+      continue;
+    }
+    matched[best] = true;
+    ++pairs;
+    BoxView other = boxes[0][best];
+    double diff = 0.0;
+    for (size_t i = 0; i < box.size(); ++i) {
+      diff = std::max<double>(diff, cv::norm(box[i] - other[i]));
+    }
+    max_diff = std::max(max_diff, diff);
+    sum_diff += diff;
+  }
+  size_t unmatched = boxes[0].size() + boxes[1].size() - 2 * pairs;
+  size_t total = std::max<size_t>(boxes[0].size(), 1);
+  std::printf(
+      "  ratio %.1f  %zu / %zu boxes  max diff %.2f px  mean diff %.2f px  "
+      "one engine only %zu  clipper %8.3f ms  analytic %8.3f ms\n",
+      unclip_ratio, boxes[0].size(), boxes[1].size(), max_diff,
+      pairs > 0 ? sum_diff / pairs : 0.0, unmatched, millis[0], millis[1]);
+  return max_diff <= kMaxCornerDiff &&
+         unmatched <= kMaxUnmatched * total;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int regions = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+  regions = std::max(regions, 1);
+  rounds = std::max(rounds, 1);
+
+  std::mt19937 rng(2025);
+  cv::Mat pred = MakeMap(1536, 2048, regions, &rng);
+  bool ok = true;
+  std::printf("1536x2048 map, %d regions, %d rounds\n", regions, rounds);
+  for (float ratio : {1.5f, 2.0f}) {
+    ok &= Compare(pred, ratio, rounds);
+  }
+  std::printf("%s\n", ok ? "OK" : "MISMATCH");
+  return ok ? 0 : 1;
+}
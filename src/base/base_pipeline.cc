@@ -13,3 +13,25 @@
 // limitations under the License.
 
 #include "base_pipeline.h"
+
+#include "src/utils/pp_option.h"
+
+absl::Status BasePipeline::SetInferBackend(YamlConfig& config) {
+  auto& data = config.Data();
+  auto backend = data.find("Global.infer_backend");
+  if (backend == data.end() || backend->second == "null") {
+    return absl::OkStatus();
+  }
+  auto dir = data.find("Global.replay_dir");
+  std::string replay_dir =
+      dir == data.end() || dir->second == "null" ? "" : dir->second;
+  // Checked here so a bad config fails before any model is loaded.
+  PaddlePredictorOption option;
+  auto status = option.SetInferBackend(backend->second, replay_dir);
+  if (!status.ok()) {
+    return status;
+  }
+  infer_backend_ = backend->second;
+  replay_dir_ = replay_dir;
+  return absl::OkStatus();
+}
@@ -24,6 +24,7 @@
 #include "absl/status/statusor.h"
 #include "base_cv_result.h"
 #include "base_predictor.h"
+#include "src/utils/yaml_config.h"
 
 class BasePipeline {
  public:
@@ -45,7 +46,16 @@ class BasePipeline {
   std::unique_ptr<BasePipeline> CreatePipeline(Args&&... args);
 
  protected:
+  // Takes `Global.infer_backend` and `Global.replay_dir` of `config` as the
+  // backend this pipeline gives its predictors and sub-pipelines. A config
+  // without the key, or with it null, keeps the current one, which a parent
+  // pipeline may have passed down.
+  absl::Status SetInferBackend(YamlConfig& config);
+
   std::string model_dir_;
+  // Empty for the build default.
+  std::string infer_backend_;
+  std::string replay_dir_;
 };
 
 template <typename T, typename... Args>
@@ -16,10 +16,17 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include <deque>
+#include <future>
 #include <iostream>
 
 #include "base_batch_sampler.h"
 #include "src/common/image_batch_sampler.h"
+#include "src/common/replay_infer.h"
+#include "src/common/thread_pool.h"
+#ifndef PPOCR_WITHOUT_PADDLE
+#include "src/common/static_infer.h"
+#endif
 #include "src/utils/ilogger.h"
 #include "src/utils/pp_option.h"
 #include "src/utils/utility.h"
@@ -28,7 +35,8 @@ BasePredictor::BasePredictor(
     const std::string& model_dir, const std::string& device,
     const std::string& precision, const bool enable_mkldnn, int batch_size,
     const std::unordered_map<std::string, std::string>& config,
-    const std::string sampler_type)
+    const std::string sampler_type, const std::string& infer_backend,
+    const std::string& replay_dir)
     : model_dir_(model_dir),
       batch_size_(batch_size),
       config_(config),
@@ -46,6 +54,13 @@ BasePredictor::BasePredictor(
   }
   model_name_ = model_name.value();
   pp_option_ptr_.reset(new PaddlePredictorOption());
+  if (!infer_backend.empty()) {
+    auto status = pp_option_ptr_->SetInferBackend(infer_backend, replay_dir);
+    if (!status.ok()) {
+      INFOE("Failed to set infer backend : %s", status.ToString().c_str());
+      return;
+    }
+  }
 
   size_t pos = device.find(':');
   std::string device_type = "";
@@ -102,9 +117,194 @@ const PaddlePredictorOption& BasePredictor::PPOption() {
 
 void BasePredictor::SetBatchSize(int batch_size) { batch_size_ = batch_size; }
 
-std::unique_ptr<PaddleInfer> BasePredictor::CreateStaticInfer() {
-  return std::unique_ptr<PaddleInfer>(
-      new PaddleInfer(model_name_, model_dir_, MODEL_FILE_PREFIX, PPOption()));
+absl::StatusOr<std::unique_ptr<InferEngine>>
+BasePredictor::CreateStaticInfer() {
+  const auto &option = PPOption();
+  if (option.InferBackend() != "paddle" && option.ReplayDir().empty()) {
+    return absl::InvalidArgumentError("infer_backend " +
+                                      option.InferBackend() +
+                                      " needs a replay_dir, set " +
+                                      "Global.replay_dir or --replay_dir");
+  }
+  if (option.InferBackend() == "replay") {
+    return std::unique_ptr<InferEngine>(
+        new ReplayInfer(model_name_, option.ReplayDir()));
+  }
+#ifdef PPOCR_WITHOUT_PADDLE
+  return absl::FailedPreconditionError(
+      "Built without Paddle Inference, only the replay backend is usable");
+#else
+  std::unique_ptr<InferEngine> infer(
+      new PaddleInfer(model_name_, model_dir_, MODEL_FILE_PREFIX, option));
+  if (option.InferBackend() == "record") {
+    infer.reset(
+        new RecordInfer(model_name_, option.ReplayDir(), std::move(infer)));
+  }
+  return std::move(infer);
+#endif
+}
+
+absl::Status BasePredictor::Preprocess(std::vector<cv::Mat> &batch_data,
+                                       BaseBatchContext &context) {
+  return absl::UnimplementedError("Preprocess is not implemented for " +
+                                  model_name_);
+}
+
+absl::Status BasePredictor::Infer(BaseBatchContext &context) {
+  return absl::UnimplementedError("Infer is not implemented for " +
+                                  model_name_);
+}
+
+std::vector<std::unique_ptr<BaseCVResult>> BasePredictor::Postprocess(
+    BaseBatchContext &context) {
+  return {};
+}
+
+absl::Status BasePredictor::SetPipelineOption(int depth, int threads) {
+  if (depth < 0 || threads < 1) {
+    return absl::InvalidArgumentError(
+        "Pipeline depth must be >= 0 and threads >= 1, got " +
+        std::to_string(depth) + " and " + std::to_string(threads));
+  }
+  pipeline_depth_ = depth;
+  pipeline_threads_ = threads;
+  if (depth == 0) {
+    pre_pool_.reset();
+    post_pool_.reset();
+    return absl::OkStatus();
+  }
+  // Kept across calls, so Predict does not start and join threads each time.
+  PaddlePool::ThreadPool::Options options;
+  options.fixed = true;
+  pre_pool_.reset(new PaddlePool::ThreadPool(threads, options));
+  // A single worker runs the postprocessing in submission order. At most
+  // depth + 1 batches wait for it, so its queue never overflows onto the
+  // calling thread.
+  options.queueCapacity = depth + 1;
+  post_pool_.reset(new PaddlePool::ThreadPool(1, options));
+  return absl::OkStatus();
+}
+
+BaseBatchContext *BasePredictor::BatchContext(size_t index) {
+  // While batch i is inferred, batches up to i + depth are preprocessed and
+  // batches from i - depth on may still wait for postprocessing.
+  size_t size = 2 * pipeline_depth_ + 1;
+  if (batch_contexts_.size() < size) {
+    for (size_t i = batch_contexts_.size(); i < size; ++i) {
+      auto context = CreateBatchContext();
+      if (context == nullptr) {
+        return nullptr;
+      }
+      batch_contexts_.push_back(std::move(context));
+    }
+  }
+  return batch_contexts_[index % size].get();
+}
+
+std::vector<std::unique_ptr<BaseCVResult>> BasePredictor::ProcessStages(
+    std::vector<cv::Mat> &batch_data) {
+  BaseBatchContext *context = BatchContext(0);
+  if (context == nullptr) {
+    INFOE("%s does not implement the process stages", model_name_.c_str());
+    return {};
+  }
+  auto status = Preprocess(batch_data, *context);
+  if (!status.ok()) {
+    INFOE(status.ToString().c_str());
+    return {};
+  }
+  status = Infer(*context);
+  if (!status.ok()) {
+    INFOE(status.ToString().c_str());
+    return {};
+  }
+  return Postprocess(*context);
+}
+
+std::vector<std::unique_ptr<BaseCVResult>> BasePredictor::PredictPipelined(
+    std::vector<std::vector<cv::Mat>> &batches) {
+  using Results = std::vector<std::unique_ptr<BaseCVResult>>;
+  std::vector<Results> outputs(batches.size());
+  RunStages(
+      batches.size(),
+      [this, &batches](size_t i, BaseBatchContext &context) {
+        return Preprocess(batches[i], context);
+      },
+      [this](size_t, BaseBatchContext &context) { return Infer(context); },
+      [this, &outputs](size_t i, BaseBatchContext &context) {
+        outputs[i] = Postprocess(context);
+        return absl::OkStatus();
+      });
+  Results result;
+  for (auto &output : outputs) {
+    for (auto &prediction : output) {
+      result.emplace_back(std::move(prediction));
+    }
+  }
+  return result;
+}
+
+absl::Status BasePredictor::RunStages(size_t count, const StageFunc &pre,
+                                      const StageFunc &infer,
+                                      const StageFunc &post) {
+  if (BatchContext(0) == nullptr) {
+    return absl::UnimplementedError(model_name_ +
+                                    " does not implement the process stages");
+  }
+  absl::Status first_error = absl::OkStatus();
+  auto check = [&first_error](const absl::Status &status) {
+    if (!status.ok()) {
+      INFOE(status.ToString().c_str());
+      if (first_error.ok()) {
+        first_error = status;
+      }
+    }
+    return status.ok();
+  };
+  if (pipeline_depth_ == 0 || count < 2) {
+    for (size_t i = 0; i < count; ++i) {
+      BaseBatchContext *context = BatchContext(i);
+      if (check(pre(i, *context)) && check(infer(i, *context))) {
+        check(post(i, *context));
+      }
+    }
+    return first_error;
+  }
+
+  std::deque<std::future<absl::Status>> pre_futures;
+  // Batch index and future of each postprocessing in flight.
+  std::deque<std::pair<size_t, std::future<absl::Status>>> post_futures;
+  auto collect = [&post_futures, &check]() {
+    check(post_futures.front().second.get());
+    post_futures.pop_front();
+  };
+  size_t depth = pipeline_depth_;
+  size_t next = 0;
+  for (size_t i = 0; i < count; ++i) {
+    for (; next < count && next <= i + depth; ++next) {
+      BaseBatchContext *context = BatchContext(next);
+      pre_futures.push_back(pre_pool_->submit(
+          [&pre, next, context]() { return pre(next, *context); }));
+    }
+    BaseBatchContext *context = BatchContext(i);
+    auto status = pre_futures.front().get();
+    pre_futures.pop_front();
+    if (check(status) && check(infer(i, *context))) {
+      post_futures.push_back(std::make_pair(
+          i, post_pool_->submit(
+                 [&post, i, context]() { return post(i, *context); })));
+    }
+    // Batch i + depth + 1, preprocessed next, takes the context of batch
+    // i - depth, which must be done by then even when batches in between
+    // failed and were never postprocessed.
+    while (!post_futures.empty() && post_futures.front().first + depth <= i) {
+      collect();
+    }
+  }
+  while (!post_futures.empty()) {
+    collect();
+  }
+  return first_error;
 }
 
 absl::Status BasePredictor::BuildBatchSampler() {
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -23,25 +24,40 @@
 #include "absl/status/statusor.h"
 #include "base_batch_sampler.h"
 #include "base_cv_result.h"
-#include "src/common/static_infer.h"
+#include "src/common/infer_engine.h"
+#include "src/common/thread_pool.h"
 #include "src/utils/func_register.h"
 #include "src/utils/pp_option.h"
 #include "src/utils/yaml_config.h"
 
+// State of one batch between the stages of Process. Each batch in flight
+// has its own context, so a batch being postprocessed keeps its output while
+// the next one is inferred.
+struct BaseBatchContext {
+  virtual ~BaseBatchContext() = default;
+  std::vector<cv::Mat> origin_image;
+  std::vector<cv::Mat> batch_input;
+  cv::Mat infer_output;
+};
+
 class BasePredictor {
  public:
+  // `infer_backend` and `replay_dir` go to PaddlePredictorOption::
+  // SetInferBackend; an empty backend keeps the build default.
   BasePredictor(const std::string &model_dir, const std::string &device = "cpu",
                 const std::string &precision = "fp32",
                 const bool enable_mkldnn = false, int batch_size = 1,
                 const std::unordered_map<std::string, std::string> &config = {},
-                const std::string sample_type = "");
+                const std::string sample_type = "",
+                const std::string &infer_backend = "",
+                const std::string &replay_dir = "");
   virtual ~BasePredictor() = default;
   std::vector<std::unique_ptr<BaseCVResult>> Predict(const std::string &input);
 
   template <typename T>
   std::vector<std::unique_ptr<BaseCVResult>> Predict(const T &input);
 
-  std::unique_ptr<PaddleInfer> CreateStaticInfer();
+  absl::StatusOr<std::unique_ptr<InferEngine>> CreateStaticInfer();
 
   const PaddlePredictorOption &PPOption();
   absl::StatusOr<std::string> ModelName() { return model_name_; };
@@ -51,6 +67,24 @@ class BasePredictor {
 
   virtual std::vector<std::unique_ptr<BaseCVResult>> Process(
       std::vector<cv::Mat> &batch_data) = 0;
+
+  // Stages of Process for predictors that can overlap batches. Preprocess
+  // runs on helper threads and must only touch `context`, Infer runs on the
+  // calling thread and Postprocess runs in batch order on one helper thread.
+  virtual std::unique_ptr<BaseBatchContext> CreateBatchContext() {
+    return nullptr;
+  };
+  virtual absl::Status Preprocess(std::vector<cv::Mat> &batch_data,
+                                  BaseBatchContext &context);
+  virtual absl::Status Infer(BaseBatchContext &context);
+  virtual std::vector<std::unique_ptr<BaseCVResult>> Postprocess(
+      BaseBatchContext &context);
+
+  // With depth > 0, Predict keeps up to `depth` batches being preprocessed
+  // on `threads` helper threads and up to `depth` batches waiting for
+  // postprocessing while the current one is inferred.
+  absl::Status SetPipelineOption(int depth, int threads);
+
   virtual void ResetResult() = 0;
   absl::Status BuildBatchSampler();
 
@@ -65,6 +99,20 @@ class BasePredictor {
   static const std::unordered_set<std::string> SAMPLER_TYPE;
 
  protected:
+  // Process built from the stages, for predictors that implement them.
+  std::vector<std::unique_ptr<BaseCVResult>> ProcessStages(
+      std::vector<cv::Mat> &batch_data);
+
+  using StageFunc = std::function<absl::Status(size_t, BaseBatchContext &)>;
+  // Runs `pre`, `infer` and `post` on batches 0..count-1, each batch in its
+  // own BatchContext, with the threading of the stages above: with a
+  // pipeline depth, batch i + 1 is prepared on pre_pool_ and batch i - 1
+  // finished on post_pool_ while batch i is inferred. A batch failing a
+  // stage skips the rest; the others still run. Returns the first error.
+  absl::Status RunStages(size_t count, const StageFunc &pre,
+                         const StageFunc &infer, const StageFunc &post);
+  BaseBatchContext *BatchContext(size_t index);
+
   std::string model_dir_;
   YamlConfig config_;
   int batch_size_;
@@ -74,6 +122,18 @@ class BasePredictor {
   std::string model_name_;
   std::string sampler_type_;
   std::unordered_map<std::string, std::unique_ptr<BaseProcessor>> pre_op_;
+  int pipeline_depth_ = 0;
+  int pipeline_threads_ = 1;
+  // Reused across calls, batch i uses entry i % size.
+  std::vector<std::unique_ptr<BaseBatchContext>> batch_contexts_;
+  // Fixed workers for the preprocessing and the postprocessing of
+  // PredictPipelined, made by SetPipelineOption.
+  std::unique_ptr<PaddlePool::ThreadPool> pre_pool_;
+  std::unique_ptr<PaddlePool::ThreadPool> post_pool_;
+
+ private:
+  std::vector<std::unique_ptr<BaseCVResult>> PredictPipelined(
+      std::vector<std::vector<cv::Mat>> &batches);
 };
 
 template <typename T, typename... Args>
@@ -92,6 +152,10 @@ std::vector<std::unique_ptr<BaseCVResult>> BasePredictor::Predict(
     INFOE("Get sample fail : %s", batches.status().ToString().c_str());
   }
   input_path_ = batch_sampler_ptr_->InputPath();
+  if (pipeline_depth_ > 0 && batches.value().size() > 1 &&
+      BatchContext(0) != nullptr) {
+    return PredictPipelined(batches.value());
+  }
   for (auto &batch_data : batches.value()) {
     auto predictions = Process(batch_data);
     for (auto &prediction : predictions) {
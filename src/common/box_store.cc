@@ -0,0 +1,81 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "box_store.h"
+
+BoxStore::BoxStore(const std::vector<std::vector<cv::Point2f>>& polys) {
+  size_t points = 0;
+  for (const auto& poly : polys) {
+    points += poly.size();
+  }
+  points_.reserve(points);
+  for (const auto& poly : polys) {
+    Add(poly);
+  }
+}
+
+void BoxStore::Reserve(size_t boxes, size_t points_per_box) {
+  points_.reserve(boxes * points_per_box);
+  if (points_per_box != 4 || !offsets_.empty()) {
+    offsets_.reserve(boxes + 1);
+  }
+}
+
+void BoxStore::Clear() {
+  points_.clear();
+  offsets_.clear();
+  size_ = 0;
+}
+
+void BoxStore::Add(const cv::Point2f* points, size_t count) {
+  if (offsets_.empty() && count != 4) {
+    offsets_.reserve(size_ + 2);
+    for (size_t i = 0; i <= size_; ++i) {
+      offsets_.push_back(static_cast<uint32_t>(4 * i));
+    }
+  }
+  points_.insert(points_.end(), points, points + count);
+  if (!offsets_.empty()) {
+    offsets_.push_back(static_cast<uint32_t>(points_.size()));
+  }
+  ++size_;
+}
+
+BoxStore BoxStore::Permute(const std::vector<int>& order) const {
+  BoxStore permuted;
+  permuted.points_.reserve(points_.size());
+  if (!offsets_.empty()) {
+    permuted.offsets_.reserve(order.size() + 1);
+    permuted.offsets_.push_back(0);
+  }
+  for (int index : order) {
+    BoxView box = (*this)[index];
+    permuted.points_.insert(permuted.points_.end(), box.begin(), box.end());
+    if (!offsets_.empty()) {
+      permuted.offsets_.push_back(
+          static_cast<uint32_t>(permuted.points_.size()));
+    }
+  }
+  permuted.size_ = order.size();
+  return permuted;
+}
+
+std::vector<std::vector<cv::Point2f>> BoxStore::ToPolys() const {
+  std::vector<std::vector<cv::Point2f>> polys;
+  polys.reserve(size_);
+  for (size_t i = 0; i < size_; ++i) {
+    polys.push_back((*this)[i].ToVector());
+  }
+  return polys;
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// The points of one box inside a BoxStore. Valid until the store changes.
+class BoxView {
+ public:
+  BoxView(const cv::Point2f* data, size_t size) : data_(data), size_(size){};
+  // A view of a single polygon. Explicit, so a temporary vector cannot
+  // turn into a view that outlives it.
+  explicit BoxView(const std::vector<cv::Point2f>& points)
+      : data_(points.data()), size_(points.size()){};
+
+  const cv::Point2f* data() const { return data_; };
+  size_t size() const { return size_; };
+  bool empty() const { return size_ == 0; };
+  const cv::Point2f* begin() const { return data_; };
+  const cv::Point2f* end() const { return data_ + size_; };
+  const cv::Point2f& operator[](size_t i) const { return data_[i]; };
+
+  // The points as an N x 1 CV_32FC2 Mat sharing their memory, for OpenCV
+  // calls taking an InputArray.
+  cv::Mat AsMat() const {
+    return cv::Mat(static_cast<int>(size_), 1, CV_32FC2,
+                   const_cast<cv::Point2f*>(data_));
+  };
+  std::vector<cv::Point2f> ToVector() const {
+    return std::vector<cv::Point2f>(begin(), end());
+  };
+
+ private:
+  const cv::Point2f* data_;
+  size_t size_;
+};
+
+// The boxes of one page in a single point buffer. While every box is a quad
+// no index is kept and box i starts at point 4 * i. The first box with
+// another point count switches the store to an offset index, which is how
+// poly boxes are held. Adding boxes to a reserved store does not allocate.
+class BoxStore {
+ public:
+  class Iterator : public std::iterator<std::forward_iterator_tag, BoxView> {
+   public:
+    Iterator(const BoxStore* store, size_t index)
+        : store_(store), index_(index){};
+    BoxView operator*() const { return (*store_)[index_]; };
+    Iterator& operator++() {
+      ++index_;
+      return *this;
+    };
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    };
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    };
+
+   private:
+    const BoxStore* store_;
+    size_t index_;
+  };
+
+  BoxStore() = default;
+  explicit BoxStore(const std::vector<std::vector<cv::Point2f>>& polys);
+
+  void Reserve(size_t boxes, size_t points_per_box = 4);
+  void Clear();
+
+  void Add(const cv::Point2f* points, size_t count);
+  void Add(const BoxView& box) { Add(box.data(), box.size()); };
+  void Add(const std::vector<cv::Point2f>& points) {
+    Add(points.data(), points.size());
+  };
+
+  size_t size() const { return size_; };
+  bool empty() const { return size_ == 0; };
+  bool AllQuads() const { return offsets_.empty(); };
+  size_t PointCount() const { return points_.size(); };
+
+  BoxView operator[](size_t i) const {
+    if (offsets_.empty()) {
+      return BoxView(points_.data() + 4 * i, 4);
+    }
+    return BoxView(points_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]);
+  };
+  Iterator begin() const { return Iterator(this, 0); };
+  Iterator end() const { return Iterator(this, size_); };
+
+  // Box order[k] of this store becomes box k of the result.
+  BoxStore Permute(const std::vector<int>& order) const;
+  std::vector<std::vector<cv::Point2f>> ToPolys() const;
+
+ private:
+  std::vector<cv::Point2f> points_;
+  // Start of each box and one past the last, empty while all are quads.
+  std::vector<uint32_t> offsets_;
+  size_t size_ = 0;
+};
@@ -0,0 +1,118 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "infer_engine.h"
+
+#include <sstream>
+
+#include "src/utils/ilogger.h"
+
+InferTensor::InferTensor(const std::string &name, const std::vector<int> &shape,
+                         CopyFunc copy_func)
+    : name_(name), shape_(shape), copy_func_(std::move(copy_func)) {}
+
+size_t InferTensor::Numel() const {
+  size_t numel = 1;
+  for (auto dim : shape_) numel *= dim;
+  return numel;
+}
+
+absl::Status InferTensor::CopyTo(cv::Mat &dst) const {
+  // create() is a no-op when the buffer already has this shape.
+  dst.create(shape_.size(), shape_.data(), CV_32F);
+  return copy_func_(dst.ptr<float>());
+}
+
+absl::StatusOr<cv::Mat> InferTensor::ToMat() const {
+  cv::Mat dst;
+  auto status = CopyTo(dst);
+  if (!status.ok()) {
+    return status;
+  }
+  return dst;
+}
+
+absl::StatusOr<std::vector<cv::Mat>> InferEngine::Apply(
+    const std::vector<cv::Mat> &x) {
+  std::vector<cv::Mat> outputs;
+  auto status = Apply(x, outputs);
+  if (!status.ok()) {
+    return status;
+  }
+  return outputs;
+};
+
+absl::Status InferEngine::Apply(const std::vector<cv::Mat> &x,
+                                std::vector<cv::Mat> &outputs) {
+  auto tensors = Run(x);
+  if (!tensors.ok()) {
+    return tensors.status();
+  }
+  outputs.resize(tensors.value().size());
+  for (size_t i = 0; i < tensors.value().size(); ++i) {
+    auto status = tensors.value()[i].CopyTo(outputs[i]);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  INFOD("%s copied %zu input bytes, shared %zu, copied %zu output bytes",
+        model_name_.c_str(), copy_stats_.input_copy_bytes,
+        copy_stats_.input_shared_bytes, copy_stats_.output_copy_bytes);
+  return absl::OkStatus();
+};
+
+std::string InputShapeKey(const std::vector<cv::Mat> &x) {
+  std::string key;
+  for (size_t i = 0; i < x.size(); ++i) {
+    if (i > 0) key += ",";
+    for (int d = 0; d < x[i].dims; ++d) {
+      if (d > 0) key += "x";
+      key += std::to_string(x[i].size[d]);
+    }
+  }
+  return key;
+}
+
+bool ShapeCacheStats::Record(const std::vector<cv::Mat> &x) {
+  std::string key = InputShapeKey(x);
+  Counter &counter = counters_[key];
+  auto entry = entries_.find(key);
+  if (entry != entries_.end()) {
+    lru_.splice(lru_.begin(), lru_, entry->second);
+    counter.hits++;
+    return true;
+  }
+  counter.misses++;
+  if (capacity_ > 0 && lru_.size() >= capacity_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(key);
+  entries_[key] = lru_.begin();
+  return false;
+}
+
+std::string ShapeCacheStats::Report() const {
+  std::ostringstream oss;
+  Counter total;
+  for (const auto &item : counters_) {
+    oss << item.first << ": " << item.second.hits << " hits, "
+        << item.second.misses << " misses\n";
+    total.hits += item.second.hits;
+    total.misses += item.second.misses;
+  }
+  oss << counters_.size() << " shapes, capacity " << capacity_ << ": "
+      << total.hits << " hits, " << total.misses << " misses";
+  return oss.str();
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <map>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+// Bytes moved between host buffers and predictor tensors by the last Apply.
+// `input_shared_bytes` were bound in place and never copied.
+struct InferCopyStats {
+  size_t input_copy_bytes = 0;
+  size_t input_shared_bytes = 0;
+  size_t output_copy_bytes = 0;
+};
+
+// One named model output of the last run. The shape is known right after the
+// run, the data is only copied to host memory when a consumer asks for it.
+// A tensor is valid until the next run of the engine that produced it.
+class InferTensor {
+ public:
+  using CopyFunc = std::function<absl::Status(float *)>;
+
+  InferTensor(const std::string &name, const std::vector<int> &shape,
+              CopyFunc copy_func);
+
+  const std::string &Name() const { return name_; };
+  const std::vector<int> &Shape() const { return shape_; };
+  size_t Numel() const;
+
+  // Copies into `dst`, reusing its buffer when the shape already matches.
+  absl::Status CopyTo(cv::Mat &dst) const;
+  absl::StatusOr<cv::Mat> ToMat() const;
+
+ private:
+  std::string name_;
+  std::vector<int> shape_;
+  CopyFunc copy_func_;
+};
+
+// The shapes of `x`, e.g. "1x3x48x320,1x2", to key per shape state by.
+std::string InputShapeKey(const std::vector<cv::Mat> &x);
+
+// Replays the input shapes an engine sees against an LRU of `capacity`
+// entries, the way oneDNN caches primitives per input shape, and counts hits
+// and misses per shape. Used to size MkldnnCacheCapacity from real traffic;
+// a capacity of 0 never evicts, like Paddle's.
+class ShapeCacheStats {
+ public:
+  struct Counter {
+    size_t hits = 0;
+    size_t misses = 0;
+  };
+
+  explicit ShapeCacheStats(size_t capacity) : capacity_(capacity){};
+
+  // Returns whether the shapes of `x` were still cached.
+  bool Record(const std::vector<cv::Mat> &x);
+
+  size_t Capacity() const { return capacity_; };
+  // Keyed by InputShapeKey, the key RecordInfer files its outputs under.
+  const std::map<std::string, Counter> &Counters() const { return counters_; };
+  // One line per shape plus a total, e.g. "1x3x48x320: 12 hits, 1 misses".
+  std::string Report() const;
+
+ private:
+  size_t capacity_;
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, std::list<std::string>::iterator> entries_;
+  std::map<std::string, Counter> counters_;
+};
+
+// Runs a model on a batch of input tensors. PaddleInfer is the real backend,
+// RecordInfer and ReplayInfer capture and serve outputs from disk so the
+// non-model code can be profiled without the inference library.
+class InferEngine {
+ public:
+  explicit InferEngine(const std::string &model_name)
+      : model_name_(model_name){};
+  virtual ~InferEngine() = default;
+
+  // Runs the model once and returns every output with its own name and
+  // shape. Nothing is copied until InferTensor::CopyTo/ToMat is called, so
+  // a predictor reading only its first head never copies the others.
+  virtual absl::StatusOr<std::vector<InferTensor>> Run(
+      const std::vector<cv::Mat> &x) = 0;
+
+  virtual const std::vector<std::string> &OutputNames() const = 0;
+
+  absl::StatusOr<std::vector<cv::Mat>> Apply(const std::vector<cv::Mat> &x);
+
+  // Writes every output straight into `outputs`. Buffers whose shape already
+  // matches are reused, so callers keeping `outputs` alive across calls avoid
+  // both the allocation and the intermediate copy.
+  absl::Status Apply(const std::vector<cv::Mat> &x,
+                     std::vector<cv::Mat> &outputs);
+
+  const std::string &ModelName() const { return model_name_; };
+  const InferCopyStats &LastCopyStats() const { return copy_stats_; };
+
+ protected:
+  std::string model_name_;
+  InferCopyStats copy_stats_;
+};
@@ -13,8 +13,10 @@
 // limitations under the License.
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -26,16 +28,26 @@
 #include "src/base/base_pipeline.h"
 #include "thread_pool.h"
 
+// Runs inputs on `thread_num` pipeline instances. An input goes to an idle
+// instance if there is one, else to the shortest queue, and an instance
+// that runs out of inputs takes the oldest one queued at the busiest other
+// instance before it goes idle, so a long page does not hold up the inputs
+// queued behind it.
 template <typename Pipeline, typename PipelineParams, typename PipelineInput,
           typename PipelineResult>
 class AutoParallelSimpleInferencePipeline : public BasePipeline {
  private:
+  struct QueuedTask {
+    PipelineInput input;
+    std::promise<PipelineResult> promise;
+  };
   struct InferenceInstance {
     std::shared_ptr<BasePipeline> pipeline;
-    std::queue<PipelineInput> task_queue;
-    std::queue<std::promise<PipelineResult>> promise_queue;
+    std::deque<QueuedTask> task_queue;
     std::mutex queue_mutex;
     std::atomic<bool> is_busy{false};
+    // Length of task_queue, readable without its lock.
+    std::atomic<size_t> queued{0};
     int instance_id;
   };
 
@@ -50,16 +62,40 @@ class AutoParallelSimpleInferencePipeline : public BasePipeline {
   absl::Status PredictThread(const PipelineInput& input);
   absl::StatusOr<PipelineResult> GetResult();
 
+  // Splits `items` into a few chunks per instance, runs them as separate
+  // inputs and joins their results in input order. Both types must be
+  // sequences, a chunk being a PipelineInput of consecutive items. Chunks
+  // hold whole groups of `group_size` items, so a pipeline batching that
+  // many items together still sees full batches. A single idle instance
+  // runs all items on the caller's thread.
+  PipelineResult PredictChunked(const PipelineInput& items,
+                                size_t group_size = 1);
+
+  // Inputs waiting at each instance, not counting the ones being run.
+  std::vector<size_t> QueueLengths() const;
+  // Inputs an instance took from another one's queue so far.
+  size_t StealCount() const { return steal_count_.load(); };
+
   virtual ~AutoParallelSimpleInferencePipeline();
 
+ protected:
+  Pipeline& Instance(int instance_id) {
+    return static_cast<Pipeline&>(*instances_[instance_id]->pipeline);
+  };
+
  private:
   void ProcessInstanceTasks(int instance_id);
+  // Instance to queue the next input at.
+  int PickInstance();
+  // Moves the oldest input of the busiest other instance into `task`.
+  bool StealTask(int thief_id, QueuedTask& task);
 
   std::string model_dir_;
   PipelineParams params_;
   int thread_num_;
 
   std::atomic<int> round_robin_index_{0};
+  std::atomic<size_t> steal_count_{0};
   std::unique_ptr<PaddlePool::ThreadPool> pool_;
   std::vector<std::unique_ptr<InferenceInstance>> instances_;
 
@@ -111,21 +147,46 @@ absl::Status AutoParallelSimpleInferencePipeline<
   return absl::OkStatus();
 }
 
+template <typename Pipeline, typename PipelineParams, typename PipelineInput,
+          typename PipelineResult>
+int AutoParallelSimpleInferencePipeline<Pipeline, PipelineParams,
+                                        PipelineInput,
+                                        PipelineResult>::PickInstance() {
+  // The scan starts at a rotating instance so ties spread out.
+  int start = round_robin_index_.fetch_add(1) % thread_num_;
+  int best = start;
+  size_t best_queued = static_cast<size_t>(-1);
+  for (int k = 0; k < thread_num_; k++) {
+    int i = (start + k) % thread_num_;
+    auto& instance = instances_[i];
+    if (!instance->is_busy.load()) {
+      return i;
+    }
+    size_t queued = instance->queued.load();
+    if (queued < best_queued) {
+      best = i;
+      best_queued = queued;
+    }
+  }
+  return best;
+}
+
 template <typename Pipeline, typename PipelineParams, typename PipelineInput,
           typename PipelineResult>
 std::future<PipelineResult> AutoParallelSimpleInferencePipeline<
     Pipeline, PipelineParams, PipelineInput,
     PipelineResult>::PredictAsync(const PipelineInput& input) {
-  int instance_id = round_robin_index_.fetch_add(1) % thread_num_;
+  int instance_id = PickInstance();
   auto& instance = instances_[instance_id];
 
-  std::promise<PipelineResult> promise;
-  auto future = promise.get_future();
+  QueuedTask task;
+  task.input = input;
+  auto future = task.promise.get_future();
 
   {
     std::lock_guard<std::mutex> lock(instance->queue_mutex);
-    instance->task_queue.push(input);
-    instance->promise_queue.push(std::move(promise));
+    instance->task_queue.push_back(std::move(task));
+    instance->queued = instance->task_queue.size();
   }
 
   bool expected = false;
@@ -137,6 +198,38 @@ std::future<PipelineResult> AutoParallelSimpleInferencePipeline<
   return future;
 }
 
+template <typename Pipeline, typename PipelineParams, typename PipelineInput,
+          typename PipelineResult>
+bool AutoParallelSimpleInferencePipeline<
+    Pipeline, PipelineParams, PipelineInput,
+    PipelineResult>::StealTask(int thief_id, QueuedTask& task) {
+  while (true) {
+    int victim = -1;
+    size_t victim_queued = 0;
+    for (int i = 0; i < thread_num_; i++) {
+      size_t queued = instances_[i]->queued.load();
+      if (i != thief_id && queued > victim_queued) {
+        victim = i;
+        victim_queued = queued;
+      }
+    }
+    if (victim < 0) {
+      return false;
+    }
+    auto& instance = instances_[victim];
+    std::lock_guard<std::mutex> lock(instance->queue_mutex);
+    // The owner may have emptied it since, then look again.
+    if (instance->task_queue.empty()) {
+      continue;
+    }
+    task = std::move(instance->task_queue.front());
+    instance->task_queue.pop_front();
+    instance->queued = instance->task_queue.size();
+    steal_count_++;
+    return true;
+  }
+}
+
 template <typename Pipeline, typename PipelineParams, typename PipelineInput,
           typename PipelineResult>
 void AutoParallelSimpleInferencePipeline<
@@ -145,33 +238,106 @@ void AutoParallelSimpleInferencePipeline<
   auto& instance = instances_[instance_id];
 
   while (true) {
-    std::vector<std::string> input;
-    std::promise<PipelineResult> promise;
+    QueuedTask task;
+    bool has_task = false;
     {
+      std::lock_guard<std::mutex> lock(instance->queue_mutex);
+      if (!instance->task_queue.empty()) {
+        task = std::move(instance->task_queue.front());
+        instance->task_queue.pop_front();
+        instance->queued = instance->task_queue.size();
+        has_task = true;
+      }
+    }
+    if (!has_task && !StealTask(instance_id, task)) {
+      std::lock_guard<std::mutex> lock(instance->queue_mutex);
+      if (!instance->task_queue.empty()) {
+        continue;
+      }
+      // Inputs queued from now on see the instance idle and restart it.
+      instance->is_busy = false;
+      return;
+    }
+    try {
+      PipelineResult result = instance->pipeline->Predict(task.input);
+      task.promise.set_value(std::move(result));
+    } catch (const std::exception& e) {
+      task.promise.set_exception(std::current_exception());
+    }
+  }
+}
+
+template <typename Pipeline, typename PipelineParams, typename PipelineInput,
+          typename PipelineResult>
+PipelineResult AutoParallelSimpleInferencePipeline<
+    Pipeline, PipelineParams, PipelineInput,
+    PipelineResult>::PredictChunked(const PipelineInput& items,
+                                    size_t group_size) {
+  if (thread_num_ == 1) {
+    auto& instance = instances_[0];
+    bool expected = false;
+    if (instance->is_busy.compare_exchange_strong(expected, true)) {
+      PipelineResult results;
+      try {
+        results = instance->pipeline->Predict(items);
+      } catch (const std::exception& e) {
+        INFOE("Failed to get inference result : %s", e.what());
+      }
+      // Inputs queued meanwhile saw the instance busy and wait for it.
       std::lock_guard<std::mutex> lock(instance->queue_mutex);
       if (instance->task_queue.empty()) {
         instance->is_busy = false;
-
-        if (!instance->task_queue.empty()) {
-          bool expected = false;
-          if (instance->is_busy.compare_exchange_strong(expected, true)) {
-            continue;
-          }
-        }
-        return;
+      } else {
+        pool_->submit([this]() { ProcessInstanceTasks(0); });
       }
-      input = std::move(instance->task_queue.front());
-      instance->task_queue.pop();
-      promise = std::move(instance->promise_queue.front());
-      instance->promise_queue.pop();
+      return results;
     }
+  }
+  // Several chunks per instance, so a slow one only delays itself while
+  // free instances pick up the rest, and fewer groups than instances still
+  // spread over all of them.
+  size_t threads = std::max(thread_num_, 1);
+  group_size = std::max<size_t>(group_size, 1);
+  size_t groups = (items.size() + group_size - 1) / group_size;
+  size_t chunk_size =
+      group_size *
+      std::max<size_t>(1, (groups + 4 * threads - 1) / (4 * threads));
+  std::vector<std::future<PipelineResult>> futures;
+  for (size_t start = 0; start < items.size(); start += chunk_size) {
+    size_t end = std::min(start + chunk_size, items.size());
+    try {
+      futures.push_back(PredictAsync(
+          PipelineInput(items.begin() + start, items.begin() + end)));
+    } catch (const std::exception& e) {
+      INFOE("Failed to submit inference : %s", e.what());
+    }
+  }
+
+  PipelineResult results;
+  for (auto& future : futures) {
     try {
-      PipelineResult result = instance->pipeline->Predict(input);
-      promise.set_value(std::move(result));
+      auto chunk_results = future.get();
+      results.insert(results.end(),
+                     std::make_move_iterator(chunk_results.begin()),
+                     std::make_move_iterator(chunk_results.end()));
     } catch (const std::exception& e) {
-      promise.set_exception(std::current_exception());
+      INFOE("Failed to get inference result : %s", e.what());
     }
   }
+  return results;
+}
+
+template <typename Pipeline, typename PipelineParams, typename PipelineInput,
+          typename PipelineResult>
+std::vector<size_t> AutoParallelSimpleInferencePipeline<
+    Pipeline, PipelineParams, PipelineInput, PipelineResult>::QueueLengths()
+    const {
+  std::vector<size_t> lengths;
+  lengths.reserve(instances_.size());
+  for (const auto& instance : instances_) {
+    lengths.push_back(instance->queued.load());
+  }
+  return lengths;
 }
 
 template <typename Pipeline, typename PipelineParams, typename PipelineInput,
@@ -230,5 +396,8 @@ AutoParallelSimpleInferencePipeline<
     while (instance->is_busy.load()) {
       std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
+    // is_busy drops while the queue lock is still held, wait for its release
+    // before the instance goes away.
+    std::lock_guard<std::mutex> lock(instance->queue_mutex);
   }
 }
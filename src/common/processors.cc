@@ -16,10 +16,12 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <numeric>
 #include <stdexcept>
 #include <unordered_map>
 
+#include "simd_kernels.h"
 #include "src/utils/ilogger.h"
 #include "src/utils/utility.h"
 
@@ -542,6 +544,93 @@ absl::StatusOr<std::vector<cv::Mat>> ToBatch::Apply(std::vector<cv::Mat>& input,
   return out;
 }
 
+NormalizeToBatch::NormalizeToBatch(float scale, const std::vector<float>& mean,
+                                   const std::vector<float>& std,
+                                   bool pad_mixed_sizes)
+    : alpha_(CHANNEL), beta_(CHANNEL), pad_mixed_sizes_(pad_mixed_sizes) {
+  assert(mean.size() == CHANNEL && std.size() == CHANNEL);
+  for (size_t i = 0; i < CHANNEL; ++i) {
+    alpha_[i] = scale / std.at(i);
+    beta_[i] = -mean.at(i) / std.at(i);
+  }
+}
+
+NormalizeToBatch::NormalizeToBatch(float scale, const float& mean,
+                                   const float& std)
+    : alpha_(CHANNEL), beta_(CHANNEL) {
+  for (size_t i = 0; i < CHANNEL; ++i) {
+    alpha_[i] = scale / std;
+    beta_[i] = -mean / std;
+  }
+}
+
+absl::StatusOr<std::vector<cv::Mat>> NormalizeToBatch::Apply(
+    std::vector<cv::Mat>& input, const void* param) const {
+  cv::Mat batch;
+  auto status = ApplyTo(input, &batch);
+  if (!status.ok()) {
+    return status;
+  }
+  return std::vector<cv::Mat>{batch};
+}
+
+absl::Status NormalizeToBatch::ApplyTo(const std::vector<cv::Mat>& input,
+                                       cv::Mat* batch) const {
+  if (input.empty()) {
+    return absl::InvalidArgumentError("Input image vector is empty.");
+  }
+  int rows = input[0].rows;
+  int cols = input[0].cols;
+  bool mixed_sizes = false;
+  for (const auto& img : input) {
+    if (img.empty() || img.channels() != CHANNEL) {
+      return absl::InvalidArgumentError("Input image must have 3 channels.");
+    }
+    if (img.depth() != CV_8U && img.depth() != CV_32F) {
+      return absl::InvalidArgumentError("Input image must be CV_8U or CV_32F.");
+    }
+    if (img.rows != rows || img.cols != cols) {
+      if (!pad_mixed_sizes_) {
+        return absl::InvalidArgumentError(
+            "All images must have the same size and number of channels.");
+      }
+      mixed_sizes = true;
+      rows = std::max(rows, img.rows);
+      cols = std::max(cols, img.cols);
+    }
+  }
+
+  std::vector<int> batch_shape = {(int)input.size(), CHANNEL, rows, cols};
+  batch->create(batch_shape.size(), batch_shape.data(), CV_32F);
+  size_t plane = static_cast<size_t>(rows) * cols;
+  for (size_t b = 0; b < input.size(); ++b) {
+    const cv::Mat& img = input[b];
+    float* dst = batch->ptr<float>() + b * CHANNEL * plane;
+    if (mixed_sizes && (img.rows != rows || img.cols != cols)) {
+      // A black pixel normalizes to beta.
+      for (int c = 0; c < CHANNEL; ++c) {
+        std::fill(dst + c * plane, dst + (c + 1) * plane, beta_[c]);
+      }
+    }
+    if (img.depth() == CV_8U) {
+      SimdKernels::NormalizeHWC3ToCHW(img.ptr<uint8_t>(), img.step[0],
+                                      img.rows, img.cols, alpha_.data(),
+                                      beta_.data(), dst, cols, plane);
+      continue;
+    }
+    for (int y = 0; y < img.rows; ++y) {
+      const float* src = img.ptr<float>(y);
+      for (int x = 0; x < img.cols; ++x) {
+        for (int c = 0; c < CHANNEL; ++c) {
+          dst[c * plane + y * cols + x] =
+              src[CHANNEL * x + c] * alpha_[c] + beta_[c];
+        }
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
 absl::StatusOr<cv::Mat> ComponentsProcessor::RotateImage(const cv::Mat& image,
                                                          int angle) {
   if (image.empty() || image.channels() != 3) {
@@ -577,54 +666,18 @@ absl::StatusOr<cv::Mat> ComponentsProcessor::RotateImage(const cv::Mat& image,
 
 std::vector<std::vector<cv::Point2f>> ComponentsProcessor::SortQuadBoxes(
     const std::vector<std::vector<cv::Point2f>>& dt_polys) {
-  std::vector<std::vector<cv::Point2f>> dt_boxes = dt_polys;
-
-  std::sort(
-      dt_boxes.begin(), dt_boxes.end(),
-      [](const std::vector<cv::Point2f>& a, const std::vector<cv::Point2f>& b) {
-        return (a[0].y < b[0].y) || (a[0].y == b[0].y && a[0].x < b[0].x);
-      });
-
-  for (size_t i = 0; i < dt_boxes.size() - 1; ++i) {
-    for (size_t j = i + 1; j > 0; --j) {
-      if (std::abs(dt_boxes[j][0].y - dt_boxes[j - 1][0].y) < 10 &&
-          dt_boxes[j][0].x < dt_boxes[j - 1][0].x) {
-        std::swap(dt_boxes[j], dt_boxes[j - 1]);
-      } else {
-        break;
-      }
-    }
-  }
-  return dt_boxes;
+  BoxStore boxes(dt_polys);
+  return boxes.Permute(ReadingOrder().Lines(boxes)).ToPolys();
 }
 
 std::vector<std::vector<cv::Point2f>> ComponentsProcessor::SortPolyBoxes(
     const std::vector<std::vector<cv::Point2f>>& dt_polys) {
-  size_t num_boxes = dt_polys.size();
-  if (num_boxes == 0) return dt_polys;
-  std::vector<int> y_min_list(num_boxes);
-  for (size_t i = 0; i < num_boxes; ++i) {
-    int y_min = dt_polys[i][0].y;
-    for (size_t j = 1; j < dt_polys[i].size(); ++j) {
-      if (dt_polys[i][j].y < y_min) {
-        y_min = dt_polys[i][j].y;
-      }
-    }
-    y_min_list[i] = y_min;
-  }
-  std::vector<size_t> rank(num_boxes);
-  std::iota(rank.begin(), rank.end(), 0);
-  std::sort(rank.begin(), rank.end(),
-            [&](size_t a, size_t b) { return y_min_list[a] < y_min_list[b]; });
-  std::vector<std::vector<cv::Point2f>> dt_polys_rank(num_boxes);
-  for (size_t i = 0; i < num_boxes; ++i) {
-    dt_polys_rank[i] = dt_polys[rank[i]];
-  }
-  return dt_polys_rank;
+  BoxStore boxes(dt_polys);
+  return boxes.Permute(ReadingOrder::ByTop(boxes)).ToPolys();
 }
 
 std::vector<std::array<float, 4>> ComponentsProcessor::ConvertPointsToBoxes(
-    const std::vector<std::vector<cv::Point2f>>& dt_polys) {
+    const BoxStore& dt_polys) {
   std::vector<std::array<float, 4>> dt_boxes;
   for (const auto& poly : dt_polys) {
     if (poly.empty()) {
@@ -646,6 +699,104 @@ std::vector<std::array<float, 4>> ComponentsProcessor::ConvertPointsToBoxes(
   return dt_boxes;
 }
 
+ReadingOrder::ReadingOrder(float row_tolerance)
+    : row_tolerance_(row_tolerance) {}
+
+std::vector<int> ReadingOrder::Lines(const BoxStore& polys) const {
+  // Page skew from the top edges of the quads, ignoring near vertical ones.
+  std::vector<float> angles;
+  for (const auto& poly : polys) {
+    if (poly.size() != 4) {
+      continue;
+    }
+    cv::Point2f top = poly[1] - poly[0];
+    if (std::abs(top.y) < std::abs(top.x)) {
+      angles.push_back(std::atan2(top.y, top.x));
+    }
+  }
+  float angle = 0.0f;
+  if (!angles.empty()) {
+    std::nth_element(angles.begin(), angles.begin() + angles.size() / 2,
+                     angles.end());
+    angle = angles[angles.size() / 2];
+  }
+  float cos_a = std::cos(angle), sin_a = std::sin(angle);
+
+  std::vector<BoxRecord> records;
+  records.reserve(polys.size());
+  for (size_t i = 0; i < polys.size(); ++i) {
+    if (polys[i].empty()) {
+      records.push_back({static_cast<int>(i), 0.0f, 0.0f, 0.0f});
+      continue;
+    }
+    float x_min = std::numeric_limits<float>::max();
+    float y_min = std::numeric_limits<float>::max();
+    float y_max = std::numeric_limits<float>::lowest();
+    for (const auto& point : polys[i]) {
+      float x = cos_a * point.x + sin_a * point.y;
+      float y = cos_a * point.y - sin_a * point.x;
+      x_min = std::min(x_min, x);
+      y_min = std::min(y_min, y);
+      y_max = std::max(y_max, y);
+    }
+    records.push_back(
+        {static_cast<int>(i), 0.5f * (y_min + y_max), y_max - y_min, x_min});
+  }
+  std::sort(records.begin(), records.end(),
+            [](const BoxRecord& a, const BoxRecord& b) {
+              return a.y_center < b.y_center ||
+                     (a.y_center == b.y_center && a.x < b.x);
+            });
+
+  // One sweep down the page. A box starts a new line when it is too far
+  // below the running center of the current one.
+  std::vector<int> order;
+  order.reserve(records.size());
+  size_t line_begin = 0;
+  float line_y = 0.0f, line_h = 0.0f;
+  auto close_line = [&](size_t end) {
+    std::sort(records.begin() + line_begin, records.begin() + end,
+              [](const BoxRecord& a, const BoxRecord& b) { return a.x < b.x; });
+    for (size_t i = line_begin; i < end; ++i) {
+      order.push_back(records[i].index);
+    }
+    line_begin = end;
+  };
+  for (size_t i = 0; i < records.size(); ++i) {
+    const BoxRecord& record = records[i];
+    size_t count = i - line_begin;
+    if (count > 0 &&
+        record.y_center - line_y >
+            row_tolerance_ * std::min(record.height, line_h)) {
+      close_line(i);
+      count = 0;
+    }
+    line_y = (line_y * count + record.y_center) / (count + 1);
+    line_h = (line_h * count + record.height) / (count + 1);
+  }
+  close_line(records.size());
+  return order;
+}
+
+std::vector<int> ReadingOrder::ByTop(const BoxStore& polys) {
+  std::vector<float> tops(polys.size(), 0.0f);
+  for (size_t i = 0; i < polys.size(); ++i) {
+    BoxView poly = polys[i];
+    if (poly.empty()) {
+      continue;
+    }
+    tops[i] = poly[0].y;
+    for (const auto& point : poly) {
+      tops[i] = std::min(tops[i], point.y);
+    }
+  }
+  std::vector<int> order(polys.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&tops](int a, int b) { return tops[a] < tops[b]; });
+  return order;
+}
+
 CropByPolys::CropByPolys(const std::string& box_type) {
   assert(box_type == "quad" || box_type == "poly");
   if (box_type == "quad") {
@@ -656,7 +807,7 @@ CropByPolys::CropByPolys(const std::string& box_type) {
 }
 
 absl::StatusOr<std::vector<cv::Mat>> CropByPolys::operator()(
-    const cv::Mat& img, const std::vector<std::vector<cv::Point2f>>& dt_polys) {
+    const cv::Mat& img, const BoxStore& dt_polys) {
   if (img.empty()) return absl::InvalidArgumentError("Input image is empty.");
   std::vector<cv::Mat> output_list;
   try {
@@ -681,16 +832,34 @@ absl::StatusOr<std::vector<cv::Mat>> CropByPolys::operator()(
   return output_list;
 }
 
+absl::StatusOr<BoxStore> CropByPolys::CropQuads(
+    const BoxStore& dt_polys) const {
+  // Quads and polys are both cropped along their min area rect.
+  BoxStore quads;
+  quads.Reserve(dt_polys.size());
+  cv::Point2f quad[4];
+  for (const auto& poly : dt_polys) {
+    if (poly.size() < 4) {
+      return absl::InvalidArgumentError(
+          "Less than 4 points for min area rect.");
+    }
+    GetMinAreaRectPoints(poly, quad);
+    quads.Add(quad, 4);
+  }
+  return quads;
+}
+
 absl::StatusOr<cv::Mat> CropByPolys::GetMinAreaRectCrop(
-    const cv::Mat& img, const std::vector<cv::Point2f>& points) const {
+    const cv::Mat& img, const BoxView& points) const {
   if (points.size() < 4)
     return absl::InvalidArgumentError("Less than 4 points for min area rect.");
-  std::vector<cv::Point2f> box = GetMinAreaRectPoints(points);
-  return GetRotateCropImage(img, box);
+  cv::Point2f box[4];
+  GetMinAreaRectPoints(points, box);
+  return GetRotateCropImage(img, BoxView(box, 4));
 }
 
 absl::StatusOr<cv::Mat> CropByPolys::GetRotateCropImage(
-    const cv::Mat& img, const std::vector<cv::Point2f>& box) const {
+    const cv::Mat& img, const BoxView& box) const {
   if (box.size() != 4)
     return absl::InvalidArgumentError("Box must have 4 points.");
   float widthTop = cv::norm(box[0] - box[1]);
@@ -701,10 +870,10 @@ absl::StatusOr<cv::Mat> CropByPolys::GetRotateCropImage(
   float heightRight = cv::norm(box[1] - box[2]);
   float maxHeight = std::max(heightLeft, heightRight);
 
-  std::vector<cv::Point2f> dst = {
+  cv::Point2f dst[4] = {
       cv::Point2f(0, 0), cv::Point2f(maxWidth - 1, 0),
       cv::Point2f(maxWidth - 1, maxHeight - 1), cv::Point2f(0, maxHeight - 1)};
-  cv::Mat M = cv::getPerspectiveTransform(box, dst);
+  cv::Mat M = cv::getPerspectiveTransform(box.data(), dst);
   cv::Mat out;
   cv::warpPerspective(img, out, M, cv::Size((int)maxWidth, (int)maxHeight),
                       cv::INTER_CUBIC, cv::BORDER_REPLICATE);
@@ -714,17 +883,22 @@ absl::StatusOr<cv::Mat> CropByPolys::GetRotateCropImage(
 }
 
 std::vector<cv::Point2f> CropByPolys::GetMinAreaRectPoints(
-    const std::vector<cv::Point2f>& poly) const {
-  auto pts = poly;
-  if (pts.size() < 4) return {};
-  cv::RotatedRect minRect = cv::minAreaRect(pts);
+    const BoxView& poly) const {
+  if (poly.size() < 4) return {};
   std::vector<cv::Point2f> box(4);
-  minRect.points(box.data());
+  GetMinAreaRectPoints(poly, box.data());
+  return box;
+}
+
+void CropByPolys::GetMinAreaRectPoints(const BoxView& poly,
+                                       cv::Point2f result[4]) const {
+  cv::RotatedRect minRect = cv::minAreaRect(poly.AsMat());
+  cv::Point2f box[4];
+  minRect.points(box);
   // 排序顺序和python版一致
-  std::sort(box.begin(), box.end(),
-            [](const cv::Point2f& a, const cv::Point2f& b) {
-              return a.x < b.x || (a.x == b.x && a.y < b.y);
-            });
+  std::sort(box, box + 4, [](const cv::Point2f& a, const cv::Point2f& b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+  });
   size_t index_a = 0, index_d = 1;
   if (box[1].y > box[0].y) {
     index_a = 0;
@@ -741,21 +915,21 @@ std::vector<cv::Point2f> CropByPolys::GetMinAreaRectPoints(
     index_b = 3;
     index_c = 2;
   }
-  return {box[index_a], box[index_b], box[index_c], box[index_d]};
+  result[0] = box[index_a];
+  result[1] = box[index_b];
+  result[2] = box[index_c];
+  result[3] = box[index_d];
 }
 
 absl::StatusOr<cv::Mat> CropByPolys::GetPolyRectCrop(
-    const cv::Mat& img, const std::vector<cv::Point2f>& poly) const {
+    const cv::Mat& img, const BoxView& poly) const {
   if (poly.size() < 4)
     return absl::InvalidArgumentError(
         "Less than 4 points for GetPolyRectCrop.");
-  // 对Poly和最小外接矩形做IoU判断
-  std::vector<cv::Point2f> minrect = GetMinAreaRectPoints(poly);
-  if (minrect.size() != 4)
-    return absl::InternalError("Failed to get minarea rect.");
-  double iou = IoU(poly, minrect);
-  // 若IoU>0.7则返回直接crop，否则可做更复杂处理，如透视矫正，可进一步实现自定义变形矫正
-  auto crop_result = GetRotateCropImage(img, minrect);
+  cv::Point2f minrect[4];
+  GetMinAreaRectPoints(poly, minrect);
+  // 若需按Poly和最小外接矩形的IoU选择透视矫正，可在此用IoU()判断
+  auto crop_result = GetRotateCropImage(img, BoxView(minrect, 4));
   if (!crop_result.ok()) return crop_result.status();
   // 测试下如果IoU很高就用直接的最小外接矩形crop，否则复杂矫正（本实现只用直接crop）
   // 若需更强几何修复，可集成TPS、ThinPlateSpline或AutoRectifier
@@ -764,8 +938,7 @@ absl::StatusOr<cv::Mat> CropByPolys::GetPolyRectCrop(
 
 const double CropByPolys::SCALE = 10000.0;
 
-ClipperLib::Path CropByPolys::CvPolyToClipperPath(
-    const std::vector<cv::Point2f>& poly) {
+ClipperLib::Path CropByPolys::CvPolyToClipperPath(const BoxView& poly) {
   ClipperLib::Path path;
   for (const auto& pt : poly)
     path.emplace_back(static_cast<ClipperLib::cInt>(std::round(pt.x * SCALE)),
@@ -773,19 +946,26 @@ ClipperLib::Path CropByPolys::CvPolyToClipperPath(
   return path;
 }
 
-double CropByPolys::IoU(const std::vector<cv::Point2f>& poly1,
-                        const std::vector<cv::Point2f>& poly2) {
-  auto path1 = CvPolyToClipperPath(poly1);
-  auto path2 = CvPolyToClipperPath(poly2);
-  ClipperLib::Paths inter_solution, union_solution;
-  ClipperLib::Clipper c_inter, c_union;
-  c_inter.AddPath(path1, ClipperLib::ptSubject, true);
-  c_inter.AddPath(path2, ClipperLib::ptClip, true);
+double CropByPolys::IntersectionArea(const BoxView& poly1,
+                                     const BoxView& poly2) {
+  ClipperLib::Paths inter_solution;
+  ClipperLib::Clipper c_inter;
+  c_inter.AddPath(CvPolyToClipperPath(poly1), ClipperLib::ptSubject, true);
+  c_inter.AddPath(CvPolyToClipperPath(poly2), ClipperLib::ptClip, true);
   c_inter.Execute(ClipperLib::ctIntersection, inter_solution,
                   ClipperLib::pftNonZero, ClipperLib::pftNonZero);
   double area_inter = 0.0;
   for (const auto& p : inter_solution)
     area_inter += std::fabs(ClipperLib::Area(p));
+  return area_inter / (SCALE * SCALE);
+}
+
+double CropByPolys::IoU(const BoxView& poly1, const BoxView& poly2) {
+  auto path1 = CvPolyToClipperPath(poly1);
+  auto path2 = CvPolyToClipperPath(poly2);
+  ClipperLib::Paths union_solution;
+  ClipperLib::Clipper c_union;
+  double area_inter = IntersectionArea(poly1, poly2);
   c_union.AddPath(path1, ClipperLib::ptSubject, true);
   c_union.AddPath(path2, ClipperLib::ptClip, true);
   c_union.Execute(ClipperLib::ctUnion, union_solution, ClipperLib::pftNonZero,
@@ -793,7 +973,6 @@ double CropByPolys::IoU(const std::vector<cv::Point2f>& poly1,
   double area_union = 0.0;
   for (const auto& p : union_solution)
     area_union += std::fabs(ClipperLib::Area(p));
-  area_inter /= (SCALE * SCALE);
   area_union /= (SCALE * SCALE);
   if (area_union < 1e-8) return 0.0;
   return area_inter / area_union;
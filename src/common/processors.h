@@ -21,6 +21,7 @@
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "box_store.h"
 #include "polyclipping/clipper.hpp"
 #include "src/utils/func_register.h"
 
@@ -127,6 +128,34 @@ class ToBatch : public BaseProcessor {
       std::vector<cv::Mat>& input, const void* param = nullptr) const override;
 };
 
+// NormalizeImage, ToCHWImage and ToBatch in one pass: each HWC image is read
+// once and written normalized into its slot of an NCHW float batch. Use
+// ApplyTo(input, &batch) to reuse the buffer of `batch` across calls. With
+// `pad_mixed_sizes` images may differ in size: the batch takes the largest
+// height and width, each image sits top left in its slot and the rest reads
+// as black pixels.
+class NormalizeToBatch : public BaseProcessor {
+ public:
+  NormalizeToBatch(float scale = 1.0 / 255.0,
+                   const std::vector<float>& mean = {0.485, 0.456, 0.406},
+                   const std::vector<float>& std = {0.229, 0.224, 0.225},
+                   bool pad_mixed_sizes = false);
+  NormalizeToBatch(float scale, const float& mean, const float& std);
+
+  absl::StatusOr<std::vector<cv::Mat>> Apply(
+      std::vector<cv::Mat>& input, const void* param = nullptr) const override;
+  // Writes the N x 3 x H x W batch into `batch`, reusing its buffer when it
+  // already has that shape.
+  absl::Status ApplyTo(const std::vector<cv::Mat>& input,
+                       cv::Mat* batch) const;
+  static constexpr int CHANNEL = 3;
+
+ private:
+  std::vector<float> alpha_;
+  std::vector<float> beta_;
+  bool pad_mixed_sizes_ = false;
+};
+
 class ComponentsProcessor {
  public:
   static absl::StatusOr<cv::Mat> RotateImage(const cv::Mat& image, int angle);
@@ -135,7 +164,35 @@ class ComponentsProcessor {
   static std::vector<std::vector<cv::Point2f>> SortPolyBoxes(
       const std::vector<std::vector<cv::Point2f>>& dt_polys);
   static std::vector<std::array<float, 4>> ConvertPointsToBoxes(
-      const std::vector<std::vector<cv::Point2f>>& dt_polys);
+      const BoxStore& dt_polys);
+};
+
+// Reading order of detected boxes as a permutation for BoxStore::Permute,
+// so polygons are never moved around while sorting.
+class ReadingOrder {
+ public:
+  // Boxes share a line when their vertical centers are within
+  // `row_tolerance` times the smaller of their height and the line's mean
+  // height. Centers are measured across the median direction of the quads'
+  // top edges, so lines on a skewed page still cluster.
+  explicit ReadingOrder(float row_tolerance = 0.5f);
+
+  // Lines top to bottom, each left to right. order[k] is the index in
+  // `polys` of the k-th box read.
+  std::vector<int> Lines(const BoxStore& polys) const;
+
+  // Top to bottom by the highest point of each box alone.
+  static std::vector<int> ByTop(const BoxStore& polys);
+
+ private:
+  struct BoxRecord {
+    int index;
+    float y_center;
+    float height;
+    float x;
+  };
+
+  float row_tolerance_;
 };
 
 class CropByPolys {
@@ -144,27 +201,39 @@ class CropByPolys {
 
   CropByPolys(const std::string& box_type = "quad");
 
-  absl::StatusOr<std::vector<cv::Mat>> operator()(
-      const cv::Mat& img,
-      const std::vector<std::vector<cv::Point2f>>& dt_polys);
+  absl::StatusOr<std::vector<cv::Mat>> operator()(const cv::Mat& img,
+                                                   const BoxStore& dt_polys);
 
-  absl::StatusOr<cv::Mat> GetMinAreaRectCrop(
-      const cv::Mat& img, const std::vector<cv::Point2f>& points) const;
+  // The boxes operator() would crop, without cropping them.
+  absl::StatusOr<BoxStore> CropQuads(const BoxStore& dt_polys) const;
 
-  absl::StatusOr<cv::Mat> GetPolyRectCrop(
-      const cv::Mat& img, const std::vector<cv::Point2f>& poly) const;
+  absl::StatusOr<cv::Mat> GetMinAreaRectCrop(const cv::Mat& img,
+                                             const BoxView& points) const;
 
-  absl::StatusOr<cv::Mat> GetRotateCropImage(
-      const cv::Mat& img, const std::vector<cv::Point2f>& box) const;
+  absl::StatusOr<cv::Mat> GetPolyRectCrop(const cv::Mat& img,
+                                          const BoxView& poly) const;
 
-  std::vector<cv::Point2f> GetMinAreaRectPoints(
-      const std::vector<cv::Point2f>& poly) const;
+  absl::StatusOr<cv::Mat> GetRotateCropImage(const cv::Mat& img,
+                                             const BoxView& box) const;
 
+  // Writes the min area rect of `poly` to `box` in crop order.
+  void GetMinAreaRectPoints(const BoxView& poly, cv::Point2f box[4]) const;
+  std::vector<cv::Point2f> GetMinAreaRectPoints(const BoxView& poly) const;
+
+  // The view overloads let boxes of a BoxStore be compared in place.
+  static double IoU(const BoxView& poly1, const BoxView& poly2);
   static double IoU(const std::vector<cv::Point2f>& poly1,
-                    const std::vector<cv::Point2f>& poly2);
+                    const std::vector<cv::Point2f>& poly2) {
+    return IoU(BoxView(poly1), BoxView(poly2));
+  };
+
+  static double IntersectionArea(const BoxView& poly1, const BoxView& poly2);
+  static double IntersectionArea(const std::vector<cv::Point2f>& poly1,
+                                 const std::vector<cv::Point2f>& poly2) {
+    return IntersectionArea(BoxView(poly1), BoxView(poly2));
+  };
 
-  static ClipperLib::Path CvPolyToClipperPath(
-      const std::vector<cv::Point2f>& poly);
+  static ClipperLib::Path CvPolyToClipperPath(const BoxView& poly);
 
   static const double SCALE;
 
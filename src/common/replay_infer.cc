@@ -0,0 +1,187 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "replay_infer.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include "src/utils/ilogger.h"
+#include "src/utils/utility.h"
+
+namespace {
+
+// Serves `mat` as a tensor, `copy_stats` counts the bytes handed out.
+InferTensor MatTensor(const std::string &name, const cv::Mat &mat,
+                      InferCopyStats *copy_stats) {
+  std::vector<int> shape(mat.size.p, mat.size.p + mat.dims);
+  return InferTensor(name, shape, [mat, copy_stats](float *dst) {
+    size_t bytes = mat.total() * mat.elemSize();
+    std::memcpy(dst, mat.ptr<float>(), bytes);
+    copy_stats->output_copy_bytes += bytes;
+    return absl::OkStatus();
+  });
+}
+
+}  // namespace
+
+std::mutex RecordInfer::count_mutex_;
+std::unordered_map<std::string, size_t> RecordInfer::run_count_;
+
+RecordInfer::RecordInfer(const std::string &model_name,
+                         const std::string &record_dir,
+                         std::unique_ptr<InferEngine> engine)
+    : InferEngine(model_name),
+      record_dir_(record_dir + PATH_SEPARATOR + model_name),
+      engine_(std::move(engine)) {
+  auto status = Utility::CreateDirectoryRecursive(record_dir_);
+  if (!status.ok()) {
+    INFOE("Create record dir failed: %s", status.ToString().c_str());
+  }
+}
+
+absl::Status RecordInfer::Save(const std::string &path,
+                               const InferRecord &record) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return absl::InternalError("Could not open record file: " + path);
+  }
+  uint32_t num = record.tensors.size();
+  file.write(reinterpret_cast<const char *>(&num), sizeof(num));
+  for (size_t i = 0; i < record.tensors.size(); ++i) {
+    const cv::Mat &tensor = record.tensors[i];
+    uint32_t name_len = record.names[i].size();
+    file.write(reinterpret_cast<const char *>(&name_len), sizeof(name_len));
+    file.write(record.names[i].data(), name_len);
+    uint32_t dims = tensor.dims;
+    file.write(reinterpret_cast<const char *>(&dims), sizeof(dims));
+    file.write(reinterpret_cast<const char *>(tensor.size.p),
+               dims * sizeof(int));
+    file.write(reinterpret_cast<const char *>(tensor.ptr<float>()),
+               tensor.total() * sizeof(float));
+  }
+  if (!file.good()) {
+    return absl::InternalError("Write record file failed: " + path);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<InferRecord> RecordInfer::Load(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return absl::NotFoundError("Could not open record file: " + path);
+  }
+  InferRecord record;
+  uint32_t num = 0;
+  file.read(reinterpret_cast<char *>(&num), sizeof(num));
+  for (uint32_t i = 0; i < num && file.good(); ++i) {
+    uint32_t name_len = 0;
+    file.read(reinterpret_cast<char *>(&name_len), sizeof(name_len));
+    std::string name(name_len, '\0');
+    file.read(&name[0], name_len);
+    uint32_t dims = 0;
+    file.read(reinterpret_cast<char *>(&dims), sizeof(dims));
+    std::vector<int> shape(dims);
+    file.read(reinterpret_cast<char *>(shape.data()), dims * sizeof(int));
+    cv::Mat tensor(dims, shape.data(), CV_32F);
+    file.read(reinterpret_cast<char *>(tensor.ptr<float>()),
+              tensor.total() * sizeof(float));
+    record.names.push_back(name);
+    record.tensors.push_back(tensor);
+  }
+  if (!file.good()) {
+    return absl::DataLossError("Truncated record file: " + path);
+  }
+  return record;
+}
+
+absl::StatusOr<std::vector<InferTensor>> RecordInfer::Run(
+    const std::vector<cv::Mat> &x) {
+  auto tensors = engine_->Run(x);
+  if (!tensors.ok()) {
+    return tensors.status();
+  }
+  record_.names.resize(tensors.value().size());
+  record_.tensors.resize(tensors.value().size());
+  for (size_t i = 0; i < tensors.value().size(); ++i) {
+    record_.names[i] = tensors.value()[i].Name();
+    auto status = tensors.value()[i].CopyTo(record_.tensors[i]);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  std::string prefix = record_dir_ + PATH_SEPARATOR + InputShapeKey(x);
+  size_t index = 0;
+  {
+    std::lock_guard<std::mutex> lock(count_mutex_);
+    index = run_count_[prefix]++;
+  }
+  auto status = Save(prefix + "_" + std::to_string(index) + ".bin", record_);
+  if (!status.ok()) {
+    return status;
+  }
+
+  copy_stats_ = engine_->LastCopyStats();
+  std::vector<InferTensor> outputs;
+  for (size_t i = 0; i < record_.tensors.size(); ++i) {
+    outputs.push_back(
+        MatTensor(record_.names[i], record_.tensors[i], &copy_stats_));
+  }
+  return outputs;
+}
+
+ReplayInfer::ReplayInfer(const std::string &model_name,
+                         const std::string &replay_dir)
+    : InferEngine(model_name),
+      replay_dir_(replay_dir + PATH_SEPARATOR + model_name) {}
+
+absl::StatusOr<std::vector<InferTensor>> ReplayInfer::Run(
+    const std::vector<cv::Mat> &x) {
+  std::string key = InputShapeKey(x);
+  auto iter = records_.find(key);
+  if (iter == records_.end()) {
+    std::vector<InferRecord> records;
+    while (true) {
+      std::string path = replay_dir_ + PATH_SEPARATOR + key + "_" +
+                         std::to_string(records.size()) + ".bin";
+      if (!Utility::FileExists(path).ok()) {
+        break;
+      }
+      auto record = RecordInfer::Load(path);
+      if (!record.ok()) {
+        return record.status();
+      }
+      records.push_back(std::move(record.value()));
+    }
+    if (records.empty()) {
+      return absl::NotFoundError("No recorded outputs of " + model_name_ +
+                                 " for input shape " + key + " in " +
+                                 replay_dir_);
+    }
+    iter = records_.emplace(key, std::move(records)).first;
+  }
+  size_t &cursor = cursor_[key];
+  const InferRecord &record = iter->second[cursor];
+  cursor = (cursor + 1) % iter->second.size();
+
+  copy_stats_ = InferCopyStats();
+  output_names_ = record.names;
+  std::vector<InferTensor> outputs;
+  for (size_t i = 0; i < record.tensors.size(); ++i) {
+    outputs.push_back(MatTensor(record.names[i], record.tensors[i],
+                                &copy_stats_));
+  }
+  return outputs;
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "infer_engine.h"
+
+// Model outputs captured for one input shape, in model output order.
+struct InferRecord {
+  std::vector<std::string> names;
+  std::vector<cv::Mat> tensors;
+};
+
+// Runs a wrapped engine and saves every batch of outputs under
+// `<record_dir>/<model_name>/<input shape>_<n>.bin`, where n counts the runs
+// of that shape in this process.
+class RecordInfer : public InferEngine {
+ public:
+  RecordInfer(const std::string &model_name, const std::string &record_dir,
+              std::unique_ptr<InferEngine> engine);
+  absl::StatusOr<std::vector<InferTensor>> Run(
+      const std::vector<cv::Mat> &x) override;
+
+  const std::vector<std::string> &OutputNames() const override {
+    return engine_->OutputNames();
+  };
+
+  static absl::Status Save(const std::string &path, const InferRecord &record);
+  static absl::StatusOr<InferRecord> Load(const std::string &path);
+
+ private:
+  std::string record_dir_;
+  std::unique_ptr<InferEngine> engine_;
+  InferRecord record_;
+
+  // Run counters per output file prefix, shared by every recorder so that
+  // several instances of one model do not overwrite each other.
+  static std::mutex count_mutex_;
+  static std::unordered_map<std::string, size_t> run_count_;
+};
+
+// Serves outputs saved by RecordInfer instead of running a model. Recordings
+// are looked up by input shape and, when a shape was recorded several times,
+// handed out in recorded order and then from the start again.
+class ReplayInfer : public InferEngine {
+ public:
+  ReplayInfer(const std::string &model_name, const std::string &replay_dir);
+  absl::StatusOr<std::vector<InferTensor>> Run(
+      const std::vector<cv::Mat> &x) override;
+
+  const std::vector<std::string> &OutputNames() const override {
+    return output_names_;
+  };
+
+ private:
+  std::string replay_dir_;
+  std::vector<std::string> output_names_;
+  std::unordered_map<std::string, std::vector<InferRecord>> records_;
+  std::unordered_map<std::string, size_t> cursor_;
+};
@@ -0,0 +1,460 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "simd_kernels.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PPOCR_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using NormalizeRowFunc = void (*)(const uint8_t*, int, const float*,
+                                  const float*, float*, float*, float*);
+using ThresholdFunc = void (*)(const float*, int, float, uint8_t*);
+using ArgMaxFunc = int (*)(const float*, int, float*);
+
+void NormalizeRowScalar(const uint8_t* src, int cols, const float* alpha,
+                        const float* beta, float* dst0, float* dst1,
+                        float* dst2) {
+  for (int x = 0; x < cols; ++x) {
+    dst0[x] = src[3 * x] * alpha[0] + beta[0];
+    dst1[x] = src[3 * x + 1] * alpha[1] + beta[1];
+    dst2[x] = src[3 * x + 2] * alpha[2] + beta[2];
+  }
+}
+
+void ThresholdScalar(const float* src, int n, float thresh, uint8_t* dst) {
+  for (int i = 0; i < n; ++i) {
+    dst[i] = src[i] > thresh ? 1 : 0;
+  }
+}
+
+int ArgMaxScalar(const float* src, int n, float* max_val) {
+  int best = 0;
+  for (int i = 1; i < n; ++i) {
+    if (src[i] > src[best]) best = i;
+  }
+  *max_val = src[best];
+  return best;
+}
+
+// Folds per lane maxima, each the first of its lane, into the first overall
+// maximum, then scans the scalar tail src[tail, n).
+int ReduceArgMax(const float* vals, const int32_t* idxs, int lanes,
+                 const float* src, int tail, int n, float* max_val) {
+  float best = vals[0];
+  int best_idx = idxs[0];
+  for (int l = 1; l < lanes; ++l) {
+    if (vals[l] > best || (vals[l] == best && idxs[l] < best_idx)) {
+      best = vals[l];
+      best_idx = idxs[l];
+    }
+  }
+  for (int i = tail; i < n; ++i) {
+    if (src[i] > best) {
+      best = src[i];
+      best_idx = i;
+    }
+  }
+  *max_val = best;
+  return best_idx;
+}
+
+#ifdef PPOCR_SIMD_X86
+
+// pshufb masks splitting 16 interleaved pixels (three 16 byte loads) into one
+// 16 byte vector per channel: kDeinterleave[c][k] picks channel c out of the
+// k-th load, 0x80 zeroes the lanes that come from another load.
+struct DeinterleaveMasks {
+  alignas(16) uint8_t mask[3][3][16];
+  DeinterleaveMasks() {
+    for (int c = 0; c < 3; ++c) {
+      for (int k = 0; k < 3; ++k) {
+        for (int i = 0; i < 16; ++i) {
+          int byte = 3 * i + c;
+          mask[c][k][i] = byte / 16 == k ? byte % 16 : 0x80;
+        }
+      }
+    }
+  }
+};
+
+const DeinterleaveMasks kDeinterleave;
+
+__attribute__((target("ssse3"))) inline void Deinterleave16(
+    const uint8_t* src, __m128i* ch) {
+  __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+  __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+  for (int c = 0; c < 3; ++c) {
+    const __m128i* m = reinterpret_cast<const __m128i*>(kDeinterleave.mask[c]);
+    ch[c] = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(v0, _mm_load_si128(m)),
+                     _mm_shuffle_epi8(v1, _mm_load_si128(m + 1))),
+        _mm_shuffle_epi8(v2, _mm_load_si128(m + 2)));
+  }
+}
+
+__attribute__((target("ssse3,sse4.1"))) void NormalizeRowSse41(
+    const uint8_t* src, int cols, const float* alpha, const float* beta,
+    float* dst0, float* dst1, float* dst2) {
+  float* dst[3] = {dst0, dst1, dst2};
+  __m128 a[3], b[3];
+  for (int c = 0; c < 3; ++c) {
+    a[c] = _mm_set1_ps(alpha[c]);
+    b[c] = _mm_set1_ps(beta[c]);
+  }
+  int x = 0;
+  for (; x + 16 <= cols; x += 16) {
+    __m128i ch[3];
+    Deinterleave16(src + 3 * x, ch);
+    for (int c = 0; c < 3; ++c) {
+      __m128i u8 = ch[c];
+      for (int q = 0; q < 4; ++q) {
+        __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(u8));
+        _mm_storeu_ps(dst[c] + x + 4 * q,
+                      _mm_add_ps(_mm_mul_ps(f, a[c]), b[c]));
+        u8 = _mm_srli_si128(u8, 4);
+      }
+    }
+  }
+  NormalizeRowScalar(src + 3 * x, cols - x, alpha, beta, dst0 + x, dst1 + x,
+                     dst2 + x);
+}
+
+__attribute__((target("ssse3,avx2,fma"))) void NormalizeRowAvx2(
+    const uint8_t* src, int cols, const float* alpha, const float* beta,
+    float* dst0, float* dst1, float* dst2) {
+  float* dst[3] = {dst0, dst1, dst2};
+  __m256 a[3], b[3];
+  for (int c = 0; c < 3; ++c) {
+    a[c] = _mm256_set1_ps(alpha[c]);
+    b[c] = _mm256_set1_ps(beta[c]);
+  }
+  int x = 0;
+  for (; x + 16 <= cols; x += 16) {
+    __m128i ch[3];
+    Deinterleave16(src + 3 * x, ch);
+    for (int c = 0; c < 3; ++c) {
+      __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(ch[c]));
+      __m256 hi =
+          _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(ch[c], 8)));
+      _mm256_storeu_ps(dst[c] + x, _mm256_fmadd_ps(lo, a[c], b[c]));
+      _mm256_storeu_ps(dst[c] + x + 8, _mm256_fmadd_ps(hi, a[c], b[c]));
+    }
+  }
+  NormalizeRowScalar(src + 3 * x, cols - x, alpha, beta, dst0 + x, dst1 + x,
+                     dst2 + x);
+}
+
+__attribute__((target("ssse3,avx512f"))) void NormalizeRowAvx512(
+    const uint8_t* src, int cols, const float* alpha, const float* beta,
+    float* dst0, float* dst1, float* dst2) {
+  float* dst[3] = {dst0, dst1, dst2};
+  __m512 a[3], b[3];
+  for (int c = 0; c < 3; ++c) {
+    a[c] = _mm512_set1_ps(alpha[c]);
+    b[c] = _mm512_set1_ps(beta[c]);
+  }
+  int x = 0;
+  for (; x + 16 <= cols; x += 16) {
+    __m128i ch[3];
+    Deinterleave16(src + 3 * x, ch);
+    for (int c = 0; c < 3; ++c) {
+      __m512 f = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(ch[c]));
+      _mm512_storeu_ps(dst[c] + x, _mm512_fmadd_ps(f, a[c], b[c]));
+    }
+  }
+  NormalizeRowScalar(src + 3 * x, cols - x, alpha, beta, dst0 + x, dst1 + x,
+                     dst2 + x);
+}
+
+// Compare results are 0 / -1 per lane; saturating packs keep them 0 / -1
+// down to bytes, the final and turns -1 into 1.
+__attribute__((target("sse4.1"))) void ThresholdSse41(const float* src, int n,
+                                                      float thresh,
+                                                      uint8_t* dst) {
+  const __m128 t = _mm_set1_ps(thresh);
+  const __m128i one = _mm_set1_epi8(1);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i m0 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(src + i), t));
+    __m128i m1 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(src + i + 4), t));
+    __m128i m2 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(src + i + 8), t));
+    __m128i m3 =
+        _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(src + i + 12), t));
+    __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(m0, m1),
+                                    _mm_packs_epi32(m2, m3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm_and_si128(bytes, one));
+  }
+  ThresholdScalar(src + i, n - i, thresh, dst + i);
+}
+
+__attribute__((target("avx2"))) void ThresholdAvx2(const float* src, int n,
+                                                   float thresh,
+                                                   uint8_t* dst) {
+  const __m256 t = _mm256_set1_ps(thresh);
+  const __m256i one = _mm256_set1_epi8(1);
+  // The packs work per 128 bit lane, this restores the element order.
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i m0 = _mm256_castps_si256(
+        _mm256_cmp_ps(_mm256_loadu_ps(src + i), t, _CMP_GT_OQ));
+    __m256i m1 = _mm256_castps_si256(
+        _mm256_cmp_ps(_mm256_loadu_ps(src + i + 8), t, _CMP_GT_OQ));
+    __m256i m2 = _mm256_castps_si256(
+        _mm256_cmp_ps(_mm256_loadu_ps(src + i + 16), t, _CMP_GT_OQ));
+    __m256i m3 = _mm256_castps_si256(
+        _mm256_cmp_ps(_mm256_loadu_ps(src + i + 24), t, _CMP_GT_OQ));
+    __m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(m0, m1),
+                                       _mm256_packs_epi32(m2, m3));
+    bytes = _mm256_permutevar8x32_epi32(bytes, order);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_and_si256(bytes, one));
+  }
+  ThresholdScalar(src + i, n - i, thresh, dst + i);
+}
+
+__attribute__((target("avx512f"))) void ThresholdAvx512(const float* src,
+                                                        int n, float thresh,
+                                                        uint8_t* dst) {
+  const __m512 t = _mm512_set1_ps(thresh);
+  const __m512i one = _mm512_set1_epi32(1);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __mmask16 mask =
+        _mm512_cmp_ps_mask(_mm512_loadu_ps(src + i), t, _CMP_GT_OQ);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i),
+        _mm512_cvtepi32_epi8(_mm512_maskz_mov_epi32(mask, one)));
+  }
+  ThresholdScalar(src + i, n - i, thresh, dst + i);
+}
+
+// The argmax kernels keep four independent (max, index) accumulators so the
+// compare and blend chains overlap; a lane only moves on a strictly larger
+// value, which keeps the first index among equal maxima.
+__attribute__((target("sse4.1"))) int ArgMaxSse41(const float* src, int n,
+                                                  float* max_val) {
+  if (n < 16) return ArgMaxScalar(src, n, max_val);
+  __m128 best[4];
+  __m128i best_idx[4], idx[4];
+  for (int k = 0; k < 4; ++k) {
+    best[k] = _mm_loadu_ps(src + 4 * k);
+    idx[k] = _mm_setr_epi32(4 * k, 4 * k + 1, 4 * k + 2, 4 * k + 3);
+    best_idx[k] = idx[k];
+  }
+  const __m128i step = _mm_set1_epi32(16);
+  int i = 16;
+  for (; i + 16 <= n; i += 16) {
+    for (int k = 0; k < 4; ++k) {
+      idx[k] = _mm_add_epi32(idx[k], step);
+      __m128 v = _mm_loadu_ps(src + i + 4 * k);
+      __m128 gt = _mm_cmpgt_ps(v, best[k]);
+      best[k] = _mm_blendv_ps(best[k], v, gt);
+      best_idx[k] =
+          _mm_blendv_epi8(best_idx[k], idx[k], _mm_castps_si128(gt));
+    }
+  }
+  alignas(16) float vals[16];
+  alignas(16) int32_t idxs[16];
+  for (int k = 0; k < 4; ++k) {
+    _mm_store_ps(vals + 4 * k, best[k]);
+    _mm_store_si128(reinterpret_cast<__m128i*>(idxs + 4 * k), best_idx[k]);
+  }
+  return ReduceArgMax(vals, idxs, 16, src, i, n, max_val);
+}
+
+__attribute__((target("avx2"))) int ArgMaxAvx2(const float* src, int n,
+                                               float* max_val) {
+  if (n < 32) return ArgMaxScalar(src, n, max_val);
+  __m256 best[4];
+  __m256i best_idx[4], idx[4];
+  for (int k = 0; k < 4; ++k) {
+    best[k] = _mm256_loadu_ps(src + 8 * k);
+    idx[k] = _mm256_add_epi32(_mm256_set1_epi32(8 * k),
+                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    best_idx[k] = idx[k];
+  }
+  const __m256i step = _mm256_set1_epi32(32);
+  int i = 32;
+  for (; i + 32 <= n; i += 32) {
+    for (int k = 0; k < 4; ++k) {
+      idx[k] = _mm256_add_epi32(idx[k], step);
+      __m256 v = _mm256_loadu_ps(src + i + 8 * k);
+      __m256 gt = _mm256_cmp_ps(v, best[k], _CMP_GT_OQ);
+      best[k] = _mm256_blendv_ps(best[k], v, gt);
+      best_idx[k] = _mm256_blendv_epi8(best_idx[k], idx[k],
+                                       _mm256_castps_si256(gt));
+    }
+  }
+  alignas(32) float vals[32];
+  alignas(32) int32_t idxs[32];
+  for (int k = 0; k < 4; ++k) {
+    _mm256_store_ps(vals + 8 * k, best[k]);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(idxs + 8 * k),
+                       best_idx[k]);
+  }
+  return ReduceArgMax(vals, idxs, 32, src, i, n, max_val);
+}
+
+__attribute__((target("avx512f"))) int ArgMaxAvx512(const float* src, int n,
+                                                    float* max_val) {
+  if (n < 64) return ArgMaxScalar(src, n, max_val);
+  __m512 best[4];
+  __m512i best_idx[4], idx[4];
+  const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                         11, 12, 13, 14, 15);
+  for (int k = 0; k < 4; ++k) {
+    best[k] = _mm512_loadu_ps(src + 16 * k);
+    idx[k] = _mm512_add_epi32(_mm512_set1_epi32(16 * k), lane);
+    best_idx[k] = idx[k];
+  }
+  const __m512i step = _mm512_set1_epi32(64);
+  int i = 64;
+  for (; i + 64 <= n; i += 64) {
+    for (int k = 0; k < 4; ++k) {
+      idx[k] = _mm512_add_epi32(idx[k], step);
+      __m512 v = _mm512_loadu_ps(src + i + 16 * k);
+      __mmask16 gt = _mm512_cmp_ps_mask(v, best[k], _CMP_GT_OQ);
+      best[k] = _mm512_mask_mov_ps(best[k], gt, v);
+      best_idx[k] = _mm512_mask_mov_epi32(best_idx[k], gt, idx[k]);
+    }
+  }
+  alignas(64) float vals[64];
+  alignas(64) int32_t idxs[64];
+  for (int k = 0; k < 4; ++k) {
+    _mm512_store_ps(vals + 16 * k, best[k]);
+    _mm512_store_si512(idxs + 16 * k, best_idx[k]);
+  }
+  return ReduceArgMax(vals, idxs, 64, src, i, n, max_val);
+}
+
+#endif  // PPOCR_SIMD_X86
+
+SimdKernels::Isa DetectIsa() {
+#ifdef PPOCR_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SimdKernels::Isa::kAvx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SimdKernels::Isa::kAvx2;
+  }
+  if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) {
+    return SimdKernels::Isa::kSse41;
+  }
+#endif
+  return SimdKernels::Isa::kScalar;
+}
+
+NormalizeRowFunc SelectNormalizeRow(SimdKernels::Isa isa) {
+#ifdef PPOCR_SIMD_X86
+  switch (isa) {
+    case SimdKernels::Isa::kAvx512:
+      return NormalizeRowAvx512;
+    case SimdKernels::Isa::kAvx2:
+      return NormalizeRowAvx2;
+    case SimdKernels::Isa::kSse41:
+      return NormalizeRowSse41;
+    default:
+      break;
+  }
+#endif
+  return NormalizeRowScalar;
+}
+
+ThresholdFunc SelectThreshold(SimdKernels::Isa isa) {
+#ifdef PPOCR_SIMD_X86
+  switch (isa) {
+    case SimdKernels::Isa::kAvx512:
+      return ThresholdAvx512;
+    case SimdKernels::Isa::kAvx2:
+      return ThresholdAvx2;
+    case SimdKernels::Isa::kSse41:
+      return ThresholdSse41;
+    default:
+      break;
+  }
+#endif
+  return ThresholdScalar;
+}
+
+ArgMaxFunc SelectArgMax(SimdKernels::Isa isa) {
+#ifdef PPOCR_SIMD_X86
+  switch (isa) {
+    case SimdKernels::Isa::kAvx512:
+      return ArgMaxAvx512;
+    case SimdKernels::Isa::kAvx2:
+      return ArgMaxAvx2;
+    case SimdKernels::Isa::kSse41:
+      return ArgMaxSse41;
+    default:
+      break;
+  }
+#endif
+  return ArgMaxScalar;
+}
+
+}  // namespace
+
+SimdKernels::Isa SimdKernels::ActiveIsa() {
+  static const Isa isa = DetectIsa();
+  return isa;
+}
+
+const char* SimdKernels::IsaName(Isa isa) {
+  switch (isa) {
+    case Isa::kAvx512:
+      return "avx512";
+    case Isa::kAvx2:
+      return "avx2";
+    case Isa::kSse41:
+      return "sse4.1";
+    default:
+      return "scalar";
+  }
+}
+
+void SimdKernels::NormalizeHWC3ToCHW(const uint8_t* src, size_t src_step,
+                                     int rows, int cols, const float* alpha,
+                                     const float* beta, float* dst) {
+  NormalizeHWC3ToCHW(src, src_step, rows, cols, alpha, beta, dst, cols,
+                     static_cast<size_t>(rows) * cols);
+}
+
+void SimdKernels::NormalizeHWC3ToCHW(const uint8_t* src, size_t src_step,
+                                     int rows, int cols, const float* alpha,
+                                     const float* beta, float* dst,
+                                     size_t dst_row_stride,
+                                     size_t dst_plane_stride, Isa isa) {
+  NormalizeRowFunc row_func = SelectNormalizeRow(isa);
+  for (int y = 0; y < rows; ++y) {
+    float* dst0 = dst + y * dst_row_stride;
+    row_func(src + y * src_step, cols, alpha, beta, dst0,
+             dst0 + dst_plane_stride, dst0 + 2 * dst_plane_stride);
+  }
+}
+
+void SimdKernels::ThresholdToMask(const float* src, int n, float thresh,
+                                  uint8_t* dst, Isa isa) {
+  SelectThreshold(isa)(src, n, thresh, dst);
+}
+
+int SimdKernels::ArgMax(const float* src, int n, float* max_val, Isa isa) {
+  return SelectArgMax(isa)(src, n, max_val);
+}
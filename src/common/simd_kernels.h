@@ -0,0 +1,53 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Hand vectorized kernels for the hot pre/post-processing loops. The widest
+// instruction set the CPU supports is picked once at runtime, so one binary
+// runs on any x86-64 machine; other targets use the scalar code.
+class SimdKernels {
+ public:
+  enum class Isa { kScalar, kSse41, kAvx2, kAvx512 };
+
+  static Isa ActiveIsa();
+  static const char* IsaName(Isa isa);
+
+  // Reads `rows` x `cols` interleaved 3-channel pixels once and writes three
+  // planes of rows * cols floats: dst[c * rows * cols + i] =
+  // src[i][c] * alpha[c] + beta[c]. `src_step` is the row stride in bytes.
+  static void NormalizeHWC3ToCHW(const uint8_t* src, size_t src_step,
+                                 int rows, int cols, const float* alpha,
+                                 const float* beta, float* dst);
+  // Same, writing into a larger tensor: output rows are `dst_row_stride`
+  // floats apart and planes `dst_plane_stride` floats apart.
+  static void NormalizeHWC3ToCHW(const uint8_t* src, size_t src_step,
+                                 int rows, int cols, const float* alpha,
+                                 const float* beta, float* dst,
+                                 size_t dst_row_stride,
+                                 size_t dst_plane_stride,
+                                 Isa isa = ActiveIsa());
+
+  // dst[i] = src[i] > thresh ? 1 : 0 for `n` floats.
+  static void ThresholdToMask(const float* src, int n, float thresh,
+                              uint8_t* dst, Isa isa = ActiveIsa());
+
+  // Index of the first largest of `n` > 0 floats, which is written to
+  // `max_val`. Inputs must not hold NaN.
+  static int ArgMax(const float* src, int n, float* max_val,
+                    Isa isa = ActiveIsa());
+};
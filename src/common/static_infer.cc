@@ -24,11 +24,11 @@ PaddleInfer::PaddleInfer(const std::string &model_name,
                          const std::string &model_dir,
                          const std::string &model_file_prefix,
                          const PaddlePredictorOption &option)
-    : model_name_(model_name),
+    : InferEngine(model_name),
       model_dir_(model_dir),
       model_file_prefix_(model_file_prefix),
       option_(option) {
-  auto result = Create();
+  auto result = option_.SharePredictor() ? CreateOrClone() : Create();
   if (!result.ok()) {
     INFOE("Create predictor failed: %s", result.status().ToString().c_str());
     return;
@@ -40,11 +40,68 @@ PaddleInfer::PaddleInfer(const std::string &model_name,
     auto handle = predictor_->GetInputHandle(name);
     input_handles_.emplace_back(std::move(handle));
   }
-  auto output_names = predictor_->GetOutputNames();
-  for (const auto &name : output_names) {
+  output_names_ = predictor_->GetOutputNames();
+  for (const auto &name : output_names_) {
     auto handle = predictor_->GetOutputHandle(name);
     output_handles_.emplace_back(std::move(handle));
   }
+  if (option_.RunMode().find("mkldnn") != std::string::npos) {
+    mkldnn_shape_stats_ = std::unique_ptr<ShapeCacheStats>(
+        new ShapeCacheStats(option_.MkldnnCacheCapacity()));
+  }
+}
+
+PaddleInfer::~PaddleInfer() {
+  if (mkldnn_shape_stats_ != nullptr &&
+      !mkldnn_shape_stats_->Counters().empty()) {
+    INFO("%s oneDNN cache by input shape:\n%s", model_name_.c_str(),
+         mkldnn_shape_stats_->Report().c_str());
+  }
+}
+
+std::mutex PaddleInfer::shared_mutex_;
+std::unordered_map<std::string, std::shared_ptr<PaddleInfer::SharedPredictor>>
+    PaddleInfer::shared_predictors_;
+
+absl::StatusOr<std::shared_ptr<paddle_infer::Predictor>>
+PaddleInfer::CreateOrClone() {
+  std::string key = model_dir_ + PATH_SEPARATOR + model_file_prefix_ + "|" +
+                    option_.DebugString();
+  std::shared_ptr<SharedPredictor> entry;
+  {
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+    auto& slot = shared_predictors_[key];
+    if (slot == nullptr) {
+      slot = std::make_shared<SharedPredictor>();
+    }
+    entry = slot;
+  }
+  // Only instances of the same model wait for a load in progress, to
+  // clone it once it is done.
+  std::lock_guard<std::mutex> lock(entry->mutex);
+  auto shared = entry->predictor.lock();
+  if (shared != nullptr) {
+    // Create() adjusts the run mode for some models, keep option_ in sync.
+    auto result_check = CheckRunMode();
+    if (!result_check.ok()) {
+      return result_check;
+    }
+    std::shared_ptr<paddle_infer::Predictor> clone = shared->Clone();
+    if (clone == nullptr) {
+      return absl::InternalError("Clone predictor failed: " + model_name_);
+    }
+    INFO("Model %s shares weights with an existing predictor",
+         model_name_.c_str());
+    // The newest instance keeps the entry alive once older ones are gone.
+    entry->predictor = clone;
+    return clone;
+  }
+  auto result = Create();
+  if (!result.ok()) {
+    return result.status();
+  }
+  entry->predictor = result.value();
+  return result.value();
 }
 
 absl::StatusOr<std::shared_ptr<paddle_infer::Predictor>> PaddleInfer::Create() {
@@ -133,42 +190,72 @@ absl::StatusOr<std::shared_ptr<paddle_infer::Predictor>> PaddleInfer::Create() {
   return predictor_shared;
 };
 
-absl::StatusOr<std::vector<cv::Mat>> PaddleInfer::Apply(
+absl::StatusOr<std::vector<InferTensor>> PaddleInfer::Run(
     const std::vector<cv::Mat> &x) {
+  if (predictor_ == nullptr) {
+    return absl::FailedPreconditionError("Predictor is not created.");
+  }
+  if (x.size() > input_handles_.size()) {
+    return absl::InvalidArgumentError(
+        "Got " + std::to_string(x.size()) + " inputs but model only has " +
+        std::to_string(input_handles_.size()));
+  }
+  copy_stats_ = InferCopyStats();
+  bool share_input = option_.EnableZeroCopy() && option_.DeviceType() == "cpu";
   for (size_t i = 0; i < x.size(); ++i) {
     auto &input_handle = input_handles_[i];
-    std::vector<int> input_shape(x[0].dims);
-    for (int i = 0; i < x[0].dims; i++) {
-      input_shape[i] = x[0].size[i];
+    std::vector<int> input_shape(x[i].dims);
+    for (int d = 0; d < x[i].dims; d++) {
+      input_shape[d] = x[i].size[d];
+    }
+    size_t input_bytes = x[i].total() * x[i].elemSize();
+    if (share_input && x[i].isContinuous() && x[i].type() == CV_32F) {
+      // x[i] outlives Run(), so the predictor can read it in place.
+      input_handle->ShareExternalData<float>(x[i].ptr<float>(), input_shape,
+                                             paddle_infer::PlaceType::kCPU);
+      copy_stats_.input_shared_bytes += input_bytes;
+    } else {
+      input_handle->Reshape(input_shape);
+      input_handle->CopyFromCpu<float>((float *)x[i].data);
+      copy_stats_.input_copy_bytes += input_bytes;
     }
-    input_handle->Reshape(input_shape);
-    input_handle->CopyFromCpu<float>((float *)x[i].data);
   }
+  if (mkldnn_shape_stats_ != nullptr && !mkldnn_shape_stats_->Record(x)) {
+    INFOD("%s oneDNN cache miss for input shape %s", model_name_.c_str(),
+          InputShapeKey(x).c_str());
+  }
+  run_id_++;
   try {
     predictor_->Run();
   } catch (const std::exception &e) {
-    std::cerr << "Exception caught: " << e.what() << std::endl;
+    return absl::InternalError(std::string("Predictor run failed: ") +
+                               e.what());
   } catch (...) {
-    std::cerr << "Unknown exception caught!" << std::endl;
-  }
-
-  std::vector<std::vector<float>> outputs;
-  std::vector<int> output_shape = {};
-  for (auto &output_handle : output_handles_) {
-    output_shape = output_handle->shape();
-    size_t numel = 1;
-    for (auto dim : output_shape) numel *= dim;
-    std::vector<float> out_data(numel);
-    output_handle->CopyToCpu(out_data.data());
-    outputs.push_back(std::move(out_data));
-  }
-  auto size_v = outputs[0].size();
-  cv::Mat pred(output_shape.size(), output_shape.data(), CV_32F);
-  memcpy(pred.ptr<float>(), outputs[0].data(),
-         outputs[0].size() * sizeof(float));
-  std::vector<cv::Mat> pred_outputs = {pred};
-  return pred_outputs;
-};
+    return absl::InternalError("Predictor run failed: unknown exception");
+  }
+
+  std::vector<InferTensor> outputs;
+  outputs.reserve(output_handles_.size());
+  for (size_t i = 0; i < output_handles_.size(); ++i) {
+    paddle_infer::Tensor *handle = output_handles_[i].get();
+    std::vector<int> output_shape = handle->shape();
+    size_t run_id = run_id_;
+    size_t bytes = sizeof(float);
+    for (auto dim : output_shape) bytes *= dim;
+    outputs.emplace_back(
+        output_names_[i], output_shape,
+        [this, handle, run_id, bytes](float *dst) -> absl::Status {
+          if (run_id != run_id_) {
+            return absl::FailedPreconditionError(
+                "Output tensor was overwritten by a later run.");
+          }
+          handle->CopyToCpu(dst);
+          copy_stats_.output_copy_bytes += bytes;
+          return absl::OkStatus();
+        });
+  }
+  return outputs;
+}
 
 absl::Status PaddleInfer::CheckRunMode() {
   if (option_.RunMode().rfind("mkldnn", 0) == 0 &&
@@ -14,36 +14,67 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "infer_engine.h"
 #include "src/utils/ilogger.h"
 #include "src/utils/pp_option.h"
 #include "third_party/paddle_inference/paddle/include/paddle_inference_api.h"
-class PaddleInfer {
+
+class PaddleInfer : public InferEngine {
  public:
   explicit PaddleInfer(const std::string &model_name,
                        const std::string &model_dir,
                        const std::string &model_file_prefix,
                        const PaddlePredictorOption &option);
-  ~PaddleInfer() = default;
-  absl::StatusOr<std::vector<cv::Mat>> Apply(
-      const std::vector<cv::Mat> &x);  //***********
+  ~PaddleInfer();
+  absl::StatusOr<std::vector<InferTensor>> Run(
+      const std::vector<cv::Mat> &x) override;
+
+  const std::vector<std::string> &OutputNames() const override {
+    return output_names_;
+  };
+
+  // Hit/miss counts of the oneDNN primitive cache per input shape, null
+  // unless the run mode is mkldnn.
+  const ShapeCacheStats *MkldnnShapeStats() const {
+    return mkldnn_shape_stats_.get();
+  };
 
  private:
   std::string model_dir_;
   std::string model_file_prefix_;
-  std::string model_name_;
   PaddlePredictorOption option_;
   std::shared_ptr<paddle_infer::Predictor> predictor_;
 
   std::vector<std::unique_ptr<paddle_infer::Tensor>> input_handles_;
   std::vector<std::unique_ptr<paddle_infer::Tensor>> output_handles_;
+  std::vector<std::string> output_names_;
+  size_t run_id_ = 0;
+  std::unique_ptr<ShapeCacheStats> mkldnn_shape_stats_;
 
   absl::StatusOr<std::shared_ptr<paddle_infer::Predictor>> Create();
+  absl::StatusOr<std::shared_ptr<paddle_infer::Predictor>> CreateOrClone();
+
+  // Loaded programs keyed by model path and options. Every PaddleInfer of the
+  // same model clones the live entry, so weights are loaded and optimized
+  // once per process and each instance only owns its execution context.
+  // shared_mutex_ guards the map only; each entry has its own mutex, held
+  // while its model loads, so different models load in parallel.
+  struct SharedPredictor {
+    std::mutex mutex;
+    std::weak_ptr<paddle_infer::Predictor> predictor;
+  };
+  static std::mutex shared_mutex_;
+  static std::unordered_map<std::string, std::shared_ptr<SharedPredictor>>
+      shared_predictors_;
 
   absl::Status CheckRunMode();
 };
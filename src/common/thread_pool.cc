@@ -14,17 +14,94 @@
 // limitations under the License.
 #include "thread_pool.h"
 
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "src/utils/ilogger.h"
+
 namespace PaddlePool {
 
+namespace {
+
+// The fixed mode pool and worker queue the calling thread belongs to.
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+
+bool pinThread(std::thread &thread, int cpu) {
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus),
+                                &cpus) == 0;
+#else
+  return false;
+#endif
+}
+
+}  // namespace
+
+constexpr size_t InlineTask::INLINE_SIZE;
 constexpr size_t ThreadPool::WAIT_SECONDS;
+constexpr int ThreadPool::SPIN_ROUNDS;
+
+std::mutex ThreadPool::sharedMutex_;
+std::unordered_map<size_t, std::weak_ptr<ThreadPool>>
+    ThreadPool::sharedPools_;
+
+std::shared_ptr<ThreadPool> ThreadPool::shared(size_t maxThreads) {
+  return shared(maxThreads, Options());
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::shared(size_t maxThreads,
+                                               const Options &options) {
+  size_t key = maxThreads * 2 + (options.fixed ? 1 : 0);
+  MutexGuard guard(sharedMutex_);
+  auto pool = sharedPools_[key].lock();
+  if (pool == nullptr) {
+    pool = std::make_shared<ThreadPool>(maxThreads, options);
+    sharedPools_[key] = pool;
+  }
+  return pool;
+}
 
 ThreadPool::ThreadPool() : ThreadPool(Thread::hardware_concurrency()) {}
 
 ThreadPool::ThreadPool(size_t maxThreads)
+    : ThreadPool(maxThreads, Options()) {}
+
+ThreadPool::ThreadPool(size_t maxThreads, const Options &options)
     : quit_(false),
       currentThreads_(0),
       idleThreads_(0),
-      maxThreads_(maxThreads) {}
+      maxThreads_(maxThreads),
+      fixed_(options.fixed && maxThreads > 0),
+      pending_(0),
+      sleepers_(0),
+      nextQueue_(0) {
+  if (!fixed_) {
+    return;
+  }
+  size_t capacity = std::max<size_t>(options.queueCapacity, 1);
+  for (size_t i = 0; i < maxThreads_; ++i) {
+    queues_.emplace_back(new WorkQueue());
+    queues_.back()->ring.resize(capacity);
+  }
+  for (size_t i = 0; i < maxThreads_; ++i) {
+    fixedThreads_.emplace_back(&ThreadPool::fixedWorker, this, i);
+    if (!options.cpus.empty()) {
+      int cpu = options.cpus[i % options.cpus.size()];
+      if (!pinThread(fixedThreads_.back(), cpu)) {
+        INFOW("Failed to pin pool worker %zu to CPU %d", i, cpu);
+      }
+    }
+  }
+  currentThreads_ = maxThreads_;
+}
 
 ThreadPool::~ThreadPool() {
   {
@@ -37,6 +114,9 @@ ThreadPool::~ThreadPool() {
     assert(elem.second.joinable());
     elem.second.join();
   }
+  for (auto &thread : fixedThreads_) {
+    thread.join();
+  }
 }
 
 size_t ThreadPool::threadsNum() const {
@@ -44,6 +124,21 @@ size_t ThreadPool::threadsNum() const {
   return currentThreads_;
 }
 
+void ThreadPool::push(Task task) {
+  MutexGuard guard(mutex_);
+  assert(!quit_);
+
+  tasks_.emplace(std::move(task));
+  if (idleThreads_ > 0) {
+    cv_.notify_one();
+  } else if (currentThreads_ < maxThreads_) {
+    Thread t(&ThreadPool::worker, this);
+    assert(threads_.find(t.get_id()) == threads_.end());
+    threads_[t.get_id()] = std::move(t);
+    ++currentThreads_;
+  }
+}
+
 void ThreadPool::worker() {
   while (true) {
     Task task;
@@ -87,4 +182,84 @@ void ThreadPool::joinFinishedThreads() {
   }
 }
 
+void ThreadPool::pushFixed(InlineTask task) {
+  size_t count = queues_.size();
+  size_t first = currentPool == this
+                     ? currentQueue
+                     : nextQueue_.fetch_add(1, std::memory_order_relaxed) %
+                           count;
+  for (size_t k = 0; k < count; ++k) {
+    WorkQueue &queue = *queues_[(first + k) % count];
+    {
+      MutexGuard guard(queue.mutex);
+      if (queue.size == queue.ring.size()) {
+        continue;
+      }
+      queue.ring[(queue.head + queue.size) % queue.ring.size()] =
+          std::move(task);
+      ++queue.size;
+      // Counted under the queue lock, so a take never sees it go negative.
+      pending_.fetch_add(1);
+    }
+    // Pairs with the sleeper count a worker raises before it checks
+    // pending_ for the last time, so either it sees the task or we see it.
+    if (sleepers_.load() > 0) {
+      MutexGuard guard(mutex_);
+      cv_.notify_one();
+    }
+    return;
+  }
+  // Every queue is full: run it here rather than block, which could
+  // deadlock when the caller is a worker itself.
+  task();
+}
+
+bool ThreadPool::takeFixed(size_t index, InlineTask *task) {
+  if (pending_.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+  size_t count = queues_.size();
+  for (size_t k = 0; k < count; ++k) {
+    WorkQueue &queue = *queues_[(index + k) % count];
+    MutexGuard guard(queue.mutex);
+    if (queue.size == 0) {
+      continue;
+    }
+    *task = std::move(queue.ring[queue.head]);
+    queue.head = (queue.head + 1) % queue.ring.size();
+    --queue.size;
+    pending_.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::fixedWorker(size_t index) {
+  currentPool = this;
+  currentQueue = index;
+  InlineTask task;
+  while (true) {
+    bool found = false;
+    for (int round = 0; round < SPIN_ROUNDS && !found; ++round) {
+      found = takeFixed(index, &task);
+      if (!found) {
+        std::this_thread::yield();
+      }
+    }
+    if (found) {
+      task();
+      task.reset();
+      continue;
+    }
+    UniqueLock uniqueLock(mutex_);
+    sleepers_.fetch_add(1);
+    cv_.wait(uniqueLock, [this]() { return quit_ || pending_.load() > 0; });
+    sleepers_.fetch_sub(1);
+    // Queued tasks still run after the pool is told to quit.
+    if (quit_ && pending_.load() == 0) {
+      return;
+    }
+  }
+}
+
 }  // namespace PaddlePool
@@ -13,18 +13,112 @@
 // limitations under the License.
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <condition_variable>
+#include <cstddef>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <queue>
 #include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace PaddlePool {
 
+// Move-only void() callable that holds callables of up to INLINE_SIZE bytes
+// in place, so making and queueing one does not allocate. Larger callables
+// are moved to the heap.
+class InlineTask {
+ public:
+  static constexpr size_t INLINE_SIZE = 64;
+
+  InlineTask() : ops_(nullptr) {}
+  template <typename Func,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<Func>::type, InlineTask>::value>::type>
+  InlineTask(Func &&func);
+  InlineTask(InlineTask &&other) noexcept : ops_(other.ops_) {
+    if (ops_ != nullptr) {
+      ops_->relocate(&storage_, &other.storage_);
+      other.ops_ = nullptr;
+    }
+  }
+  InlineTask &operator=(InlineTask &&other) noexcept {
+    if (this != &other) {
+      reset();
+      ops_ = other.ops_;
+      if (ops_ != nullptr) {
+        ops_->relocate(&storage_, &other.storage_);
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+  ~InlineTask() { reset(); }
+
+  InlineTask(const InlineTask &) = delete;
+  InlineTask &operator=(const InlineTask &) = delete;
+
+  void operator()() { ops_->invoke(&storage_); }
+  explicit operator bool() const { return ops_ != nullptr; }
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  struct Ops {
+    void (*invoke)(void *);
+    // Moves the callable at src to dst and destroys the one at src.
+    void (*relocate)(void *dst, void *src);
+    void (*destroy)(void *);
+  };
+  template <typename F>
+  struct LocalOps {
+    static void invoke(void *p) { (*static_cast<F *>(p))(); }
+    static void relocate(void *dst, void *src) {
+      new (dst) F(std::move(*static_cast<F *>(src)));
+      static_cast<F *>(src)->~F();
+    }
+    static void destroy(void *p) { static_cast<F *>(p)->~F(); }
+  };
+  template <typename F>
+  struct HeapOps {
+    static F *&held(void *p) { return *static_cast<F **>(p); }
+    static void invoke(void *p) { (*held(p))(); }
+    static void relocate(void *dst, void *src) { new (dst) F *(held(src)); }
+    static void destroy(void *p) { delete held(p); }
+  };
+  template <typename F, typename Func>
+  void emplace(Func &&func, std::true_type);
+  template <typename F, typename Func>
+  void emplace(Func &&func, std::false_type);
+  template <typename F>
+  static const Ops *opsOf(std::true_type) {
+    static const Ops ops = {&LocalOps<F>::invoke, &LocalOps<F>::relocate,
+                            &LocalOps<F>::destroy};
+    return &ops;
+  }
+  template <typename F>
+  static const Ops *opsOf(std::false_type) {
+    static const Ops ops = {&HeapOps<F>::invoke, &HeapOps<F>::relocate,
+                            &HeapOps<F>::destroy};
+    return &ops;
+  }
+
+  typename std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type
+      storage_;
+  const Ops *ops_;
+};
+
 class ThreadPool {
  public:
   using MutexGuard = std::lock_guard<std::mutex>;
@@ -33,8 +127,23 @@ class ThreadPool {
   using ThreadID = std::thread::id;
   using Task = std::function<void()>;
 
+  struct Options {
+    // Starts all `maxThreads` workers up front and keeps them until the
+    // pool is destroyed, instead of starting them on demand and letting
+    // them exit after WAIT_SECONDS idle. Each worker has its own bounded
+    // queue of InlineTask and takes from the others once it runs dry.
+    bool fixed = false;
+    // Fixed mode only: worker i is pinned to CPU cpus[i % cpus.size()].
+    // Empty leaves the workers to the scheduler.
+    std::vector<int> cpus;
+    // Fixed mode only: tasks each worker queue holds. A task submitted
+    // while all queues are full runs on the submitting thread.
+    size_t queueCapacity = 256;
+  };
+
   ThreadPool();
   explicit ThreadPool(size_t maxThreads);
+  ThreadPool(size_t maxThreads, const Options &options);
 
   ThreadPool(const ThreadPool &) = delete;
   ThreadPool &operator=(const ThreadPool &) = delete;
@@ -44,13 +153,46 @@ class ThreadPool {
   template <typename Func, typename... Ts>
   auto submit(Func &&func, Ts &&...params)
       -> std::future<typename std::result_of<Func(Ts...)>::type>;
+  // Runs func() without a future to report back. In fixed mode this does
+  // not allocate unless func is larger than InlineTask::INLINE_SIZE.
+  // func must not throw.
+  template <typename Func>
+  void post(Func &&func);
 
   size_t threadsNum() const;
+  size_t maxThreadsNum() const { return maxThreads_; };
+  bool isFixed() const { return fixed_; };
+
+  // Process wide pool of `maxThreads` threads, shared by every caller
+  // asking for the same size and mode while any of them holds it. The
+  // first caller's options apply.
+  static std::shared_ptr<ThreadPool> shared(size_t maxThreads);
+  static std::shared_ptr<ThreadPool> shared(size_t maxThreads,
+                                            const Options &options);
 
  private:
   static constexpr size_t WAIT_SECONDS = 2;
+  // Times an idle fixed mode worker looks for work again before it sleeps.
+  static constexpr int SPIN_ROUNDS = 64;
+
+  struct WorkQueue {
+    std::mutex mutex;
+    std::vector<InlineTask> ring;
+    size_t head = 0;
+    size_t size = 0;
+  };
+
   void worker();
   void joinFinishedThreads();
+  // Queues task and wakes an idle worker for it or starts a new one.
+  void push(Task task);
+
+  void fixedWorker(size_t index);
+  // Queues task at the calling worker's own queue, or at the next queue in
+  // turn for other threads, trying the rest while one is full.
+  void pushFixed(InlineTask task);
+  // Takes the oldest task of queue `index`, else of the other queues.
+  bool takeFixed(size_t index, InlineTask *task);
 
   bool quit_;
   size_t currentThreads_;
@@ -62,12 +204,52 @@ class ThreadPool {
   std::queue<Task> tasks_;
   std::queue<ThreadID> finishedThreadIDs_;
   std::unordered_map<ThreadID, Thread> threads_;
+
+  bool fixed_;
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::vector<Thread> fixedThreads_;
+  // Tasks in the fixed mode queues and workers asleep waiting for one.
+  std::atomic<size_t> pending_;
+  std::atomic<size_t> sleepers_;
+  std::atomic<size_t> nextQueue_;
+
+  static std::mutex sharedMutex_;
+  static std::unordered_map<size_t, std::weak_ptr<ThreadPool>> sharedPools_;
 };
 
+// Runs func(i) for every i in [0, n) on up to `maxTasks` pool tasks plus
+// the calling thread, and returns once all calls are done. Indices are
+// claimed from a shared counter, so the caller only ever waits for calls
+// that are already running: nested use and use from pool threads cannot
+// deadlock. `func` must be safe to call concurrently.
+template <typename Func>
+void parallelFor(ThreadPool *pool, size_t n, size_t maxTasks, Func func);
+
 }  // namespace PaddlePool
 
 namespace PaddlePool {
 
+template <typename Func, typename>
+InlineTask::InlineTask(Func &&func) {
+  using F = typename std::decay<Func>::type;
+  using FitsInline = std::integral_constant<
+      bool, sizeof(F) <= INLINE_SIZE &&
+                alignof(F) <= alignof(std::max_align_t) &&
+                std::is_nothrow_move_constructible<F>::value>;
+  emplace<F>(std::forward<Func>(func), FitsInline());
+  ops_ = opsOf<F>(FitsInline());
+}
+
+template <typename F, typename Func>
+void InlineTask::emplace(Func &&func, std::true_type) {
+  new (&storage_) F(std::forward<Func>(func));
+}
+
+template <typename F, typename Func>
+void InlineTask::emplace(Func &&func, std::false_type) {
+  new (&storage_) F *(new F(std::forward<Func>(func)));
+}
+
 template <typename Func, typename... Ts>
 auto ThreadPool::submit(Func &&func, Ts &&...params)
     -> std::future<typename std::result_of<Func(Ts...)>::type> {
@@ -77,23 +259,67 @@ auto ThreadPool::submit(Func &&func, Ts &&...params)
   using ReturnType = typename std::result_of<Func(Ts...)>::type;
   using PackagedTask = std::packaged_task<ReturnType()>;
 
+  if (fixed_) {
+    // A packaged_task is a pointer to its shared state, so it fits in
+    // place and the state is the only allocation.
+    PackagedTask task(std::move(execute));
+    auto result = task.get_future();
+    pushFixed(InlineTask(std::move(task)));
+    return result;
+  }
+
   auto task = std::make_shared<PackagedTask>(std::move(execute));
   auto result = task->get_future();
+  push([task]() { (*task)(); });
+  return result;
+}
 
-  MutexGuard guard(mutex_);
-  assert(!quit_);
-
-  tasks_.emplace([task]() { (*task)(); });
-  if (idleThreads_ > 0) {
-    cv_.notify_one();
-  } else if (currentThreads_ < maxThreads_) {
-    Thread t(&ThreadPool::worker, this);
-    assert(threads_.find(t.get_id()) == threads_.end());
-    threads_[t.get_id()] = std::move(t);
-    ++currentThreads_;
+template <typename Func>
+void ThreadPool::post(Func &&func) {
+  if (fixed_) {
+    pushFixed(InlineTask(std::forward<Func>(func)));
+    return;
   }
+  push(Task(std::forward<Func>(func)));
+}
 
-  return result;
+}  // namespace PaddlePool
+
+namespace PaddlePool {
+
+template <typename Func>
+void parallelFor(ThreadPool *pool, size_t n, size_t maxTasks, Func func) {
+  struct State {
+    std::atomic<size_t> next{0};
+    size_t done = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+  auto state = std::make_shared<State>();
+  size_t n_total = n;
+  // Late tasks find nothing left to claim and never touch `func`'s
+  // captures, so only the shared state has to outlive this call.
+  auto run = [state, n_total, func]() {
+    size_t finished = 0;
+    for (size_t i = state->next++; i < n_total; i = state->next++) {
+      func(i);
+      ++finished;
+    }
+    if (finished > 0) {
+      std::lock_guard<std::mutex> guard(state->mutex);
+      state->done += finished;
+      if (state->done == n_total) state->cv.notify_all();
+    }
+  };
+  if (pool != nullptr && n > 1) {
+    size_t tasks = std::min(std::min(maxTasks, n - 1), pool->maxThreadsNum());
+    for (size_t t = 0; t < tasks; ++t) {
+      pool->post(run);
+    }
+  }
+  run();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&state, n_total]() { return state->done == n_total; });
 }
 
 }  // namespace PaddlePool
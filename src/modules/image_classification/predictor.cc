@@ -33,9 +33,14 @@ ClasPredictor::ClasPredictor(const std::string& model_dir,
                              const ClasPredictorParams& params)
     : BasePredictor(model_dir, params.device, params.precision,
                     params.enable_mkldnn, params.batch_size, params.config,
-                    "image"),
+                    "image", params.infer_backend, params.replay_dir),
       params_(params),
       topk_(params.topk) {
+  auto status =
+      SetPipelineOption(params.pipeline_depth, params.pipeline_threads);
+  if (!status.ok()) {
+    INFOE("Cls pipeline option is invalid : %s", status.ToString().c_str());
+  }
   Build();
 };
 
@@ -67,16 +72,20 @@ void ClasPredictor::Build() {
                    YamlConfig::SmartParseVector(pre_params.at("CropImage.size"))
                        .vec_int);  //*************
   }
-  Register<NormalizeImage>(
-      "Normalize", std::stof(pre_params.at("NormalizeImage.scale")),
+  // Normalize, ToCHW and ToBatch fused into one pass over each image.
+  to_batch_ = std::unique_ptr<NormalizeToBatch>(new NormalizeToBatch(
+      std::stof(pre_params.at("NormalizeImage.scale")),
       YamlConfig::SmartParseVector(pre_params.at("NormalizeImage.mean"))
           .vec_float,
       YamlConfig::SmartParseVector(pre_params.at("NormalizeImage.std"))
-          .vec_float);
-  Register<ToCHWImage>("ToCHW");
-  Register<ToBatch>("ToBatch");
+          .vec_float));
 
-  infer_ptr_ = CreateStaticInfer();
+  auto infer = CreateStaticInfer();
+  if (!infer.ok()) {
+    INFOE("Create infer engine fail : %s", infer.status().ToString().c_str());
+    std::exit(-1);
+  }
+  infer_ptr_ = std::move(infer.value());
   const auto& post_params = config_.PostProcessOpInfo();
   auto gsj = YamlConfig::SmartParseVector(
       post_params.at("PostProcess.Topk.label_list"));
@@ -89,51 +98,49 @@ void ClasPredictor::Build() {
 
 std::vector<std::unique_ptr<BaseCVResult>> ClasPredictor::Process(
     std::vector<cv::Mat>& batch_data) {
-  std::vector<cv::Mat> origin_image = {};
-  origin_image.reserve(batch_data.size());
+  return ProcessStages(batch_data);
+}
+
+absl::Status ClasPredictor::Preprocess(std::vector<cv::Mat>& batch_data,
+                                       BaseBatchContext& context) {
+  context.origin_image.clear();
+  context.origin_image.reserve(batch_data.size());
   for (const auto& mat : batch_data) {
-    origin_image.push_back(mat.clone());
+    context.origin_image.push_back(mat.clone());
   }
   auto batch_read = pre_op_.at("Read")->Apply(batch_data);
-
   if (!batch_read.ok()) {
-    INFOE(batch_read.status().ToString().c_str());
+    return batch_read.status();
   }
 
   auto batch_resize = pre_op_.at("Resize")->Apply(batch_read.value());
   if (!batch_resize.ok()) {
-    INFOE(batch_resize.status().ToString().c_str());
+    return batch_resize.status();
   }
   if (config_.FindKey("Crop").ok()) {
     batch_resize = pre_op_.at("Crop")->Apply(batch_resize.value());  // **
     if (!batch_resize.ok()) {
-      INFOE(batch_resize.status().ToString().c_str());
+      return batch_resize.status();
     }
   }
-  auto batch_normalize = pre_op_.at("Normalize")->Apply(batch_resize.value());
-  if (!batch_normalize.ok()) {
-    INFOE(batch_normalize.status().ToString().c_str());
-  }
-
-  auto batch_tochw = pre_op_.at("ToCHW")->Apply(batch_normalize.value());
-  if (!batch_tochw.ok()) {
-    INFOE(batch_tochw.status().ToString().c_str());
-  }
-
-  auto batch_tobatch = pre_op_.at("ToBatch")->Apply(batch_tochw.value());
-  if (!batch_tobatch.ok()) {
-    INFOE(batch_tobatch.status().ToString().c_str());
-  }
+  context.batch_input.resize(1);
+  return to_batch_->ApplyTo(batch_resize.value(), &context.batch_input[0]);
+}
 
-  auto batch_infer = infer_ptr_->Apply(batch_tobatch.value());
+absl::Status ClasPredictor::Infer(BaseBatchContext& context) {
+  auto batch_infer = infer_ptr_->Run(context.batch_input);
   if (!batch_infer.ok()) {
-    INFOE(batch_infer.status().ToString().c_str());
+    return batch_infer.status();
   }
+  return batch_infer.value()[0].CopyTo(context.infer_output);
+}
 
-  auto cls_result = post_op_.at("Topk")->Apply(batch_infer.value()[0]);
-
+std::vector<std::unique_ptr<BaseCVResult>> ClasPredictor::Postprocess(
+    BaseBatchContext& context) {
+  auto cls_result = post_op_.at("Topk")->Apply(context.infer_output);
   if (!cls_result.ok()) {
     INFOE(cls_result.status().ToString().c_str());
+    return {};
   }
 
   std::vector<std::unique_ptr<BaseCVResult>> base_cv_result_ptr_vec = {};
@@ -143,7 +150,7 @@ std::vector<std::unique_ptr<BaseCVResult>> ClasPredictor::Process(
       if (input_index_ == input_path_.size()) input_index_ = 0;
       predictor_result.input_path = input_path_[input_index_];
     }
-    predictor_result.input_image = origin_image[i];
+    predictor_result.input_image = context.origin_image[i];
     predictor_result.class_ids = cls_result.value()[i].class_ids;
     predictor_result.scores = cls_result.value()[i].scores;
     predictor_result.label_names = cls_result.value()[i].label_names;
@@ -151,6 +158,5 @@ std::vector<std::unique_ptr<BaseCVResult>> ClasPredictor::Process(
     base_cv_result_ptr_vec.push_back(
         std::unique_ptr<BaseCVResult>(new TopkResult(predictor_result)));
   }
-
   return base_cv_result_ptr_vec;
 }
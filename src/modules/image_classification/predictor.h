@@ -27,6 +27,11 @@ struct ClasPredictorParams {
   int batch_size = 1;
   std::unordered_map<std::string, std::string> config = {};
   int topk = 1;
+  // Empty keeps the build default, see BasePredictor.
+  std::string infer_backend = "";
+  std::string replay_dir = "";
+  int pipeline_depth = 0;
+  int pipeline_threads = 1;
 };
 
 struct ClasPredictorResult {
@@ -57,6 +62,15 @@ class ClasPredictor : public BasePredictor {
   std::vector<std::unique_ptr<BaseCVResult>> Process(
       std::vector<cv::Mat>& batch_data) override;
 
+  std::unique_ptr<BaseBatchContext> CreateBatchContext() override {
+    return std::unique_ptr<BaseBatchContext>(new BaseBatchContext());
+  };
+  absl::Status Preprocess(std::vector<cv::Mat>& batch_data,
+                          BaseBatchContext& context) override;
+  absl::Status Infer(BaseBatchContext& context) override;
+  std::vector<std::unique_ptr<BaseCVResult>> Postprocess(
+      BaseBatchContext& context) override;
+
   std::vector<ClasPredictorResult> PredictorResult() const {
     return predictor_result_vec_;
   };
@@ -70,7 +84,8 @@ class ClasPredictor : public BasePredictor {
 
   std::unordered_map<std::string, std::unique_ptr<Topk>> post_op_;
   std::vector<ClasPredictorResult> predictor_result_vec_;
-  std::unique_ptr<PaddleInfer> infer_ptr_;
+  std::unique_ptr<InferEngine> infer_ptr_;
+  std::unique_ptr<NormalizeToBatch> to_batch_;
 
   ClasPredictorParams params_;
   int input_index_ = 0;
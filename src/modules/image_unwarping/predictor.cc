@@ -30,7 +30,7 @@ WarpPredictor::WarpPredictor(const std::string& model_dir,
                              const WarpPredictorParams& params)
     : BasePredictor(model_dir, params.device, params.precision,
                     params.enable_mkldnn, params.batch_size, params.config,
-                    "image"),
+                    "image", params.infer_backend, params.replay_dir),
       params_(params) {
   Build();
 };
@@ -38,11 +38,16 @@ WarpPredictor::WarpPredictor(const std::string& model_dir,
 void WarpPredictor::Build() {
   const auto& pre_params = config_.PreProcessOpInfo();
   Register<ReadImage>("Read", "BGR");
-  Register<Normalize>("Normalize", 1.0 / 255.0, 0.0, 1.0);
-  Register<ToCHWImage>("ToCHW");
-  Register<ToBatch>("ToBatch");
+  // Normalize, ToCHW and ToBatch fused into one pass over each image.
+  to_batch_ = std::unique_ptr<NormalizeToBatch>(
+      new NormalizeToBatch(1.0 / 255.0, 0.0, 1.0));
 
-  infer_ptr_ = CreateStaticInfer();
+  auto infer = CreateStaticInfer();
+  if (!infer.ok()) {
+    INFOE("Create infer engine fail : %s", infer.status().ToString().c_str());
+    std::exit(-1);
+  }
+  infer_ptr_ = std::move(infer.value());
   const auto& post_params = config_.PostProcessOpInfo();
   post_op_["DocTr"] = std::unique_ptr<DocTrPostProcess>(new DocTrPostProcess());
 };
@@ -59,23 +64,22 @@ std::vector<std::unique_ptr<BaseCVResult>> WarpPredictor::Process(
     INFOE(batch_read.status().ToString().c_str());
   }
 
-  auto batch_normalize = pre_op_.at("Normalize")->Apply(batch_read.value());
-  if (!batch_normalize.ok()) {
-    INFOE(batch_normalize.status().ToString().c_str());
-  }
-  auto batch_tochw = pre_op_.at("ToCHW")->Apply(batch_normalize.value());
-  if (!batch_tochw.ok()) {
-    INFOE(batch_tochw.status().ToString().c_str());
+  auto status_batch = to_batch_->ApplyTo(batch_read.value(), &batch_input_);
+  if (!status_batch.ok()) {
+    INFOE(status_batch.ToString().c_str());
+    return {};
   }
-  auto batch_tobatch = pre_op_.at("ToBatch")->Apply(batch_tochw.value());
-  if (!batch_tobatch.ok()) {
-    INFOE(batch_tobatch.status().ToString().c_str());
-  }
-  auto batch_infer = infer_ptr_->Apply(batch_tobatch.value());
+  auto batch_infer = infer_ptr_->Run({batch_input_});
   if (!batch_infer.ok()) {
     INFOE(batch_infer.status().ToString().c_str());
+    return {};
+  }
+  auto status_copy = batch_infer.value()[0].CopyTo(infer_output_);
+  if (!status_copy.ok()) {
+    INFOE(status_copy.ToString().c_str());
+    return {};
   }
-  auto warp_result = post_op_.at("DocTr")->Apply(batch_infer.value()[0]);
+  auto warp_result = post_op_.at("DocTr")->Apply(infer_output_);
 
   if (!warp_result.ok()) {
     INFOE(warp_result.status().ToString().c_str());
@@ -26,6 +26,9 @@ struct WarpPredictorParams {
   bool enable_mkldnn = false;
   int batch_size = 1;
   std::unordered_map<std::string, std::string> config = {};
+  // Empty keeps the build default, see BasePredictor.
+  std::string infer_backend = "";
+  std::string replay_dir = "";
 };
 
 struct WarpPredictorResult {
@@ -58,7 +61,10 @@ class WarpPredictor : public BasePredictor {
  private:
   std::unordered_map<std::string, std::unique_ptr<DocTrPostProcess>> post_op_;
   std::vector<WarpPredictorResult> predictor_result_vec_;
-  std::unique_ptr<PaddleInfer> infer_ptr_;
+  std::unique_ptr<InferEngine> infer_ptr_;
+  std::unique_ptr<NormalizeToBatch> to_batch_;
+  cv::Mat batch_input_;
+  cv::Mat infer_output_;
   WarpPredictorParams params_;
   int input_index_ = 0;
 };
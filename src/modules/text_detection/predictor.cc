@@ -41,7 +41,7 @@ TextDetPredictor::TextDetPredictor(const std::string& model_dir,
                                    const TextDetPredictorParams& params)
     : BasePredictor(model_dir, params.device, params.precision,
                     params.enable_mkldnn, params.batch_size, params.config,
-                    "image"),
+                    "image", params.infer_backend, params.replay_dir),
       params_(params),
       limit_side_len_(params.limit_side_len),
       limit_type_(params.limit_type),
@@ -59,18 +59,101 @@ void TextDetPredictor::Build() {
 
   Register<DetResizeForTest>(
       "Resize", std::stoi(pre_tfs.at("DetResizeForTest.resize_long")));
-  Register<NormalizeImage>("Normalize");
-  Register<ToCHWImage>("ToCHW");
-  Register<ToBatch>("ToBatch");
-  infer_ptr_ = CreateStaticInfer();
+  // Normalize, ToCHW and ToBatch fused into one pass over each image. Pages
+  // of different sizes share a batch padded to the largest of them; the
+  // DetShapeInfo of each page keeps DBPostProcess off the padding.
+  to_batch_ = std::unique_ptr<NormalizeToBatch>(new NormalizeToBatch(
+      1.0f / 255.0f, std::vector<float>{0.485f, 0.456f, 0.406f},
+      std::vector<float>{0.229f, 0.224f, 0.225f}, true));
+  auto infer = CreateStaticInfer();
+  if (!infer.ok()) {
+    INFOE("Create infer engine fail : %s", infer.status().ToString().c_str());
+    std::exit(-1);
+  }
+  infer_ptr_ = std::move(infer.value());
   const auto& post_params = config_.PostProcessOpInfo();
   post_op_["DBPostProcess"] = std::unique_ptr<DBPostProcess>(
       new DBPostProcess(std::stof(post_params.at("PostProcess.thresh")),
                         std::stof(post_params.at("PostProcess.box_thresh")),
                         std::stoi(post_params.at("PostProcess.max_candidates")),
-                        std::stof(post_params.at("PostProcess.unclip_ratio"))));
+                        std::stof(post_params.at("PostProcess.unclip_ratio")),
+                        false, "fast", "quad", params_.box_extractor));
+  auto status = post_op_["DBPostProcess"]->SetScoreEngine(
+      params_.score_engine);
+  if (!status.ok()) {
+    INFOE("Invalid det score engine : %s", status.ToString().c_str());
+  }
+  status = post_op_["DBPostProcess"]->SetUnclipEngine(params_.unclip_engine);
+  if (!status.ok()) {
+    INFOE("Invalid det unclip engine : %s", status.ToString().c_str());
+  }
+  if (params_.parallel_postprocess) {
+    // Every batch fans out on this pool, keep its workers between batches.
+    PaddlePool::ThreadPool::Options pool_options;
+    pool_options.fixed = true;
+    post_op_["DBPostProcess"]->SetThreadPool(PaddlePool::ThreadPool::shared(
+        std::max(PPOption().CpuThreads(), 1), pool_options));
+  }
+  if (params_.tile_size > 0) {
+    tiler_ = std::unique_ptr<DetTiler>(
+        new DetTiler(params_.tile_size, params_.tile_overlap,
+                     params_.tile_min_side, params_.tile_merge_overlap));
+  }
 };
 
+absl::StatusOr<std::vector<std::pair<BoxStore, std::vector<float>>>>
+TextDetPredictor::Detect(std::vector<cv::Mat>& images,
+                         const std::vector<cv::Size>& canvases) {
+  std::vector<DetShapeInfo> shape_infos;
+  DetResizeForTestParam resize_param;
+  resize_param.limit_side_len = limit_side_len_;
+  resize_param.limit_type = limit_type_;
+  resize_param.max_side_limit = max_side_limit_;
+  resize_param.canvases = canvases;
+  resize_param.shape_info = &shape_infos;
+  auto batch_imgs = pre_op_.at("Resize")->Apply(images, &resize_param);
+  if (!batch_imgs.ok()) {
+    return batch_imgs.status();
+  }
+  auto status_batch = to_batch_->ApplyTo(batch_imgs.value(), &batch_input_);
+  if (!status_batch.ok()) {
+    return status_batch;
+  }
+  auto infer_result = infer_ptr_->Run({batch_input_});
+  if (!infer_result.ok()) {
+    return infer_result.status();
+  }
+  auto status_copy = infer_result.value()[0].CopyTo(infer_output_);
+  if (!status_copy.ok()) {
+    return status_copy;
+  }
+  return post_op_.at("DBPostProcess")->Apply(infer_output_, shape_infos);
+}
+
+absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
+TextDetPredictor::DetectTiled(const cv::Mat& page) {
+  auto tiles = tiler_->Tiles(page.rows, page.cols);
+  std::vector<std::pair<BoxStore, std::vector<float>>>
+      tile_results;
+  tile_results.reserve(tiles.size());
+  size_t step = std::max(params_.tile_batch_size, 1);
+  for (size_t begin = 0; begin < tiles.size(); begin += step) {
+    std::vector<cv::Mat> tile_imgs;
+    for (size_t t = begin; t < std::min(tiles.size(), begin + step); ++t) {
+      tile_imgs.push_back(page(tiles[t]));
+    }
+    // Tiles already share one shape, canvases would only shrink them.
+    auto result = Detect(tile_imgs, {});
+    if (!result.ok()) {
+      return result.status();
+    }
+    for (auto& boxes : result.value()) {
+      tile_results.push_back(std::move(boxes));
+    }
+  }
+  return tiler_->Merge(tiles, tile_results);
+}
+
 std::vector<std::unique_ptr<BaseCVResult>> TextDetPredictor::Process(
     std::vector<cv::Mat>& batch_data) {
   std::vector<cv::Mat> origin_image = {};
@@ -81,55 +164,47 @@ std::vector<std::unique_ptr<BaseCVResult>> TextDetPredictor::Process(
   auto batch_raw_imgs = pre_op_.at("Read")->Apply(batch_data);
   if (!batch_raw_imgs.ok()) {
     INFOE(batch_raw_imgs.status().ToString().c_str());
+    return {};
   }
-  std::vector<int> origin_shape = {batch_raw_imgs.value()[0].rows,
-                                   batch_raw_imgs.value()[0].cols};
-  DetResizeForTestParam resize_param;
-  resize_param.limit_side_len = limit_side_len_;
-  resize_param.limit_type = limit_type_;
-  resize_param.max_side_limit = max_side_limit_;
-  auto batch_imgs =
-      pre_op_.at("Resize")->Apply(batch_raw_imgs.value(), &resize_param);
-  if (!batch_imgs.ok()) {
-    INFOE(batch_imgs.status().ToString().c_str());
-  }
-  auto batch_imgs_normalize =
-      pre_op_.at("Normalize")->Apply(batch_imgs.value());
-  if (!batch_imgs_normalize.ok()) {
-    INFOE(batch_imgs_normalize.status().ToString().c_str());
-  }
-
-  auto batch_imgs_to_chw =
-      pre_op_.at("ToCHW")->Apply(batch_imgs_normalize.value());
-  if (!batch_imgs_to_chw.ok()) {
-    INFOE(batch_imgs_to_chw.status().ToString().c_str());
-  }
-  auto batch_imgs_to_batch =
-      pre_op_.at("ToBatch")->Apply(batch_imgs_to_chw.value());
-  if (!batch_imgs_to_batch.ok()) {
-    INFOE(batch_imgs_to_batch.status().ToString().c_str());
-  }
-  auto infer_result = infer_ptr_->Apply(batch_imgs_to_batch.value());
-  if (!infer_result.ok()) {
-    INFOE(infer_result.status().ToString().c_str());
+  std::vector<std::pair<BoxStore, std::vector<float>>>
+      page_boxes(batch_raw_imgs.value().size());
+  std::vector<cv::Mat> whole_pages;
+  std::vector<size_t> whole_index;
+  for (size_t i = 0; i < batch_raw_imgs.value().size(); ++i) {
+    const cv::Mat& page = batch_raw_imgs.value()[i];
+    if (tiler_ != nullptr && tiler_->ShouldTile(page)) {
+      auto tiled = DetectTiled(page);
+      if (!tiled.ok()) {
+        INFOE(tiled.status().ToString().c_str());
+        return {};
+      }
+      page_boxes[i] = std::move(tiled.value());
+    } else {
+      whole_pages.push_back(page);
+      whole_index.push_back(i);
+    }
   }
-  auto db_result = post_op_.at("DBPostProcess")
-                       ->Apply(infer_result.value()[0], origin_shape);
-
-  if (!db_result.ok()) {
-    INFOE(db_result.status().ToString().c_str());
+  if (!whole_pages.empty()) {
+    auto db_result = Detect(whole_pages, params_.canvas_shapes);
+    if (!db_result.ok()) {
+      INFOE(db_result.status().ToString().c_str());
+      return {};
+    }
+    for (size_t k = 0; k < whole_index.size(); ++k) {
+      page_boxes[whole_index[k]] = std::move(db_result.value()[k]);
+    }
   }
 
   std::vector<std::unique_ptr<BaseCVResult>> base_cv_result_ptr_vec = {};
-  for (int i = 0; i < db_result.value().size(); i++, input_index_++) {
+  for (int i = 0; i < page_boxes.size(); i++, input_index_++) {
     TextDetPredictorResult predictor_result;
     if (!input_path_.empty()) {
       if (input_index_ == input_path_.size()) input_index_ = 0;
       predictor_result.input_path = input_path_[input_index_];
     }
     predictor_result.input_image = origin_image[i];
-    predictor_result.dt_polys = db_result.value()[i].first;
-    predictor_result.dt_scores = db_result.value()[i].second;
+    predictor_result.dt_polys = std::move(page_boxes[i].first);
+    predictor_result.dt_scores = std::move(page_boxes[i].second);
     predictor_result_vec_.push_back(predictor_result);
     base_cv_result_ptr_vec.push_back(
         std::unique_ptr<BaseCVResult>(new TextDetResult(predictor_result)));
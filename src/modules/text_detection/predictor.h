@@ -23,7 +23,7 @@
 struct TextDetPredictorResult {
   std::string input_path = "";
   cv::Mat input_image;
-  std::vector<std::vector<cv::Point2f>> dt_polys = {};
+  BoxStore dt_polys;
   std::vector<float> dt_scores = {};
 };
 
@@ -33,6 +33,9 @@ struct TextDetPredictorParams {
   bool enable_mkldnn = false;
   int batch_size = 1;
   std::unordered_map<std::string, std::string> config = {};
+  // Empty keeps the build default, see BasePredictor.
+  std::string infer_backend = "";
+  std::string replay_dir = "";
   int limit_side_len = 64;
   std::string limit_type = "min";
   float thresh = 0.3;
@@ -40,6 +43,25 @@ struct TextDetPredictorParams {
   float unclip_ratio = 1.5;
   std::vector<int> input_shape = {};
   int max_side_limit = 4000;
+  // Canvases pages are padded onto, see DetResizeForTestParam::canvases.
+  std::vector<cv::Size> canvas_shapes = {};
+  // "contour" or "ccl", see DBPostProcess.
+  std::string box_extractor = "contour";
+  // "mask" or "integral", see DBPostProcess::SetScoreEngine.
+  std::string score_engine = "mask";
+  // "clipper" or "analytic", see DBPostProcess::SetUnclipEngine.
+  std::string unclip_engine = "clipper";
+  // Runs postprocessing on a fixed pool of CpuThreads() workers shared with
+  // other predictors of the same budget.
+  bool parallel_postprocess = false;
+  // Pages whose longer side exceeds tile_min_side are detected in tiles of
+  // tile_size overlapping by tile_overlap, tile_batch_size tiles per run,
+  // instead of being shrunk. 0 disables tiling. See DetTiler.
+  int tile_size = 0;
+  int tile_overlap = 128;
+  int tile_min_side = 4000;
+  int tile_batch_size = 4;
+  float tile_merge_overlap = 0.5;
 };
 
 class TextDetPredictor : public BasePredictor {
@@ -70,6 +92,14 @@ class TextDetPredictor : public BasePredictor {
       std::vector<cv::Mat> &batch_data) override;
 
  private:
+  // Resize, infer and postprocess `images` as one batch.
+  absl::StatusOr<std::vector<std::pair<BoxStore, std::vector<float>>>>
+  Detect(std::vector<cv::Mat> &images, const std::vector<cv::Size> &canvases);
+  // Detect one page through tiler_, tile_batch_size tiles at a time, so peak
+  // memory follows the tile size rather than the page size.
+  absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
+  DetectTiled(const cv::Mat &page);
+
   int limit_side_len_;
   std::string limit_type_;
   float thresh_;
@@ -79,8 +109,12 @@ class TextDetPredictor : public BasePredictor {
   int max_side_limit_;
 
   std::unordered_map<std::string, std::unique_ptr<DBPostProcess>> post_op_;
+  std::unique_ptr<DetTiler> tiler_;
   std::vector<TextDetPredictorResult> predictor_result_vec_;
-  std::unique_ptr<PaddleInfer> infer_ptr_;
+  std::unique_ptr<InferEngine> infer_ptr_;
+  std::unique_ptr<NormalizeToBatch> to_batch_;
+  cv::Mat batch_input_;
+  cv::Mat infer_output_;
   TextDetPredictorParams params_;
   int input_index_ = 0;
 };
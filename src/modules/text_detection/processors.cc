@@ -14,8 +14,14 @@
 
 #include "processors.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
 #include <stdexcept>
 
+#include "src/common/processors.h"
+#include "src/common/simd_kernels.h"
 #include "src/utils/utility.h"
 
 DetResizeForTest::DetResizeForTest(int resize_long,
@@ -50,6 +56,9 @@ absl::StatusOr<std::vector<cv::Mat>> DetResizeForTest::Apply(
   if (param_ptr != nullptr) {
     const DetResizeForTestParam* param =
         static_cast<const DetResizeForTestParam*>(param_ptr);
+    if (param->shape_info != nullptr) {
+      param->shape_info->clear();
+    }
     for (const auto& img : input) {
       auto res = Resize(
           img,
@@ -57,7 +66,19 @@ absl::StatusOr<std::vector<cv::Mat>> DetResizeForTest::Apply(
           !param->limit_type.empty() ? param->limit_type : limit_type_,
           param->max_side_limit > 0 ? param->max_side_limit : max_side_limit_);
       if (!res.ok()) return res.status();
-      results.push_back(res.value());
+      DetShapeInfo info;
+      info.src_h = img.rows;
+      info.src_w = img.cols;
+      info.resize_h = res.value().rows;
+      info.resize_w = res.value().cols;
+      if (param->canvases.empty()) {
+        results.push_back(res.value());
+      } else {
+        results.push_back(SnapToCanvas(res.value(), param->canvases, info));
+      }
+      if (param->shape_info != nullptr) {
+        param->shape_info->push_back(info);
+      }
     }
   } else {
     for (const auto& img : input) {
@@ -69,6 +90,63 @@ absl::StatusOr<std::vector<cv::Mat>> DetResizeForTest::Apply(
   return results;
 }
 
+absl::StatusOr<std::vector<cv::Size>> DetResizeForTest::ParseCanvases(
+    const std::vector<std::string>& canvases) {
+  std::vector<cv::Size> sizes;
+  for (const auto& canvas : canvases) {
+    int width = 0, height = 0;
+    char sep = 0;
+    std::istringstream iss(canvas);
+    if (!(iss >> width >> sep >> height) || (sep != 'x' && sep != 'X') ||
+        width <= 0 || height <= 0 || width % 32 != 0 || height % 32 != 0) {
+      return absl::InvalidArgumentError(
+          "Canvas must be WxH with multiples of 32, got: " + canvas);
+    }
+    sizes.emplace_back(width, height);
+  }
+  return sizes;
+}
+
+cv::Mat DetResizeForTest::SnapToCanvas(const cv::Mat& img,
+                                       const std::vector<cv::Size>& canvases,
+                                       DetShapeInfo& info) const {
+  const cv::Size* best = nullptr;
+  for (const auto& canvas : canvases) {
+    if (canvas.width >= img.cols && canvas.height >= img.rows &&
+        (best == nullptr || canvas.area() < best->area())) {
+      best = &canvas;
+    }
+  }
+  cv::Mat page = img;
+  if (best == nullptr) {
+    // Too large for every canvas: shrink onto the one keeping most pixels.
+    float best_scale = 0.f;
+    for (const auto& canvas : canvases) {
+      float scale = std::min((float)canvas.width / img.cols,
+                             (float)canvas.height / img.rows);
+      if (best == nullptr || scale > best_scale) {
+        best = &canvas;
+        best_scale = scale;
+      }
+    }
+    int resize_w = std::max(std::min(int(img.cols * best_scale), best->width),
+                            1);
+    int resize_h = std::max(
+        std::min(int(img.rows * best_scale), best->height), 1);
+    cv::resize(img, page, cv::Size(resize_w, resize_h));
+  }
+  info.resize_h = page.rows;
+  info.resize_w = page.cols;
+  if (page.rows == best->height && page.cols == best->width) {
+    return page;
+  }
+  cv::Mat canvas;
+  cv::copyMakeBorder(page, canvas, 0, best->height - page.rows, 0,
+                     best->width - page.cols, cv::BORDER_CONSTANT,
+                     cv::Scalar::all(0));
+  return canvas;
+}
+
 absl::StatusOr<cv::Mat> DetResizeForTest::Resize(const cv::Mat& img,
                                                  int limit_side_len,
                                                  const std::string& limit_type,
@@ -196,10 +274,145 @@ absl::StatusOr<cv::Mat> DetResizeForTest::ResizeImageType3(
   return resized;
 }
 
+BoxScorer::BoxScorer(const cv::Mat& pred)
+    : rows_(pred.rows), cols_(pred.cols) {
+  cv::integral(pred, integral_, CV_64F);
+}
+
+void BoxScorer::AddSpan(int y, int x0, int x1, double& sum,
+                        int64_t& count) const {
+  x0 = std::max(x0, 0);
+  x1 = std::min(x1, cols_ - 1);
+  if (y < 0 || y >= rows_ || x0 > x1) {
+    return;
+  }
+  const double* top = integral_.ptr<double>(y);
+  const double* bottom = integral_.ptr<double>(y + 1);
+  sum += bottom[x1 + 1] - top[x1 + 1] - bottom[x0] + top[x0];
+  count += x1 - x0 + 1;
+}
+
+float BoxScorer::RectMean(int x0, int y0, int x1, int y1) const {
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, cols_ - 1);
+  y1 = std::min(y1, rows_ - 1);
+  if (x0 > x1 || y0 > y1) {
+    return 0.0f;
+  }
+  const double* top = integral_.ptr<double>(y0);
+  const double* bottom = integral_.ptr<double>(y1 + 1);
+  double sum = bottom[x1 + 1] - top[x1 + 1] - bottom[x0] + top[x0];
+  return static_cast<float>(sum / ((x1 - x0 + 1) * (y1 - y0 + 1)));
+}
+
+float BoxScorer::PolygonMean(const std::vector<cv::Point2f>& polygon,
+                             bool convex) const {
+  std::vector<cv::Point2f> points;
+  std::vector<float> crossings;
+  return PolygonMean(polygon, convex, points, crossings);
+}
+
+float BoxScorer::PolygonMean(const std::vector<cv::Point2f>& polygon,
+                             bool convex, std::vector<cv::Point2f>& points,
+                             std::vector<float>& crossings) const {
+  if (polygon.empty()) {
+    return 0.0f;
+  }
+  points.clear();
+  float ymin = 0.f, ymax = 0.f;
+  for (size_t i = 0; i < polygon.size(); ++i) {
+    cv::Point2f point(std::max(std::floor(polygon[i].x), 0.f),
+                      std::max(std::floor(polygon[i].y), 0.f));
+    ymin = i == 0 ? point.y : std::min(ymin, point.y);
+    ymax = i == 0 ? point.y : std::max(ymax, point.y);
+    points.push_back(point);
+  }
+  size_t n = points.size();
+  double sum = 0.0;
+  int64_t count = 0;
+  int row_begin = std::max(static_cast<int>(ymin), 0);
+  int row_end = std::min(static_cast<int>(ymax), rows_ - 1);
+  for (int y = row_begin; y <= row_end; ++y) {
+    if (convex) {
+      // x extent of the polygon within the row's strip, every pixel it
+      // overlaps counts.
+      float lo = std::max(y - 0.5f, ymin);
+      float hi = std::min(y + 0.5f, ymax);
+      float xmin = std::numeric_limits<float>::max();
+      float xmax = std::numeric_limits<float>::lowest();
+      for (size_t i = 0; i < n; ++i) {
+        const cv::Point2f& a = points[i];
+        const cv::Point2f& b = points[(i + 1) % n];
+        float e_lo = std::max(std::min(a.y, b.y), lo);
+        float e_hi = std::min(std::max(a.y, b.y), hi);
+        if (e_lo > e_hi) {
+          continue;
+        }
+        float xs[2];
+        if (a.y == b.y) {
+          xs[0] = a.x;
+          xs[1] = b.x;
+        } else {
+          float slope = (b.x - a.x) / (b.y - a.y);
+          xs[0] = a.x + (e_lo - a.y) * slope;
+          xs[1] = a.x + (e_hi - a.y) * slope;
+        }
+        xmin = std::min(xmin, std::min(xs[0], xs[1]));
+        xmax = std::max(xmax, std::max(xs[0], xs[1]));
+      }
+      if (xmin <= xmax) {
+        AddSpan(y, static_cast<int>(std::floor(xmin - 0.5f)) + 1,
+                static_cast<int>(std::ceil(xmax + 0.5f)) - 1, sum, count);
+      }
+      continue;
+    }
+    // Even-odd spans at the pixel centers of the row. Edges are half open
+    // towards the bottom, except on the last row so it is not lost.
+    crossings.clear();
+    bool last_row = y == static_cast<int>(ymax);
+    for (size_t i = 0; i < n; ++i) {
+      const cv::Point2f& a = points[i];
+      const cv::Point2f& b = points[(i + 1) % n];
+      float top = std::min(a.y, b.y);
+      float bottom = std::max(a.y, b.y);
+      if (top < bottom && (last_row ? top < y && y <= bottom
+                                    : top <= y && y < bottom)) {
+        crossings.push_back(a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y));
+      }
+    }
+    std::sort(crossings.begin(), crossings.end());
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+      AddSpan(y, static_cast<int>(std::ceil(crossings[i])),
+              static_cast<int>(std::floor(crossings[i + 1])), sum, count);
+    }
+  }
+  return count > 0 ? static_cast<float>(sum / count) : 0.0f;
+}
+
+std::vector<float> BoxScorer::PolygonMeans(
+    const std::vector<std::vector<cv::Point2f>>& polygons,
+    bool convex) const {
+  std::vector<float> means(polygons.size());
+  PolygonMeans(polygons, convex, 0, polygons.size(), means.data());
+  return means;
+}
+
+void BoxScorer::PolygonMeans(
+    const std::vector<std::vector<cv::Point2f>>& polygons, bool convex,
+    size_t begin, size_t end, float* means) const {
+  std::vector<cv::Point2f> points;
+  std::vector<float> crossings;
+  for (size_t i = begin; i < end; ++i) {
+    means[i] = PolygonMean(polygons[i], convex, points, crossings);
+  }
+}
+
 DBPostProcess::DBPostProcess(float thresh, float box_thresh, int max_candidates,
                              float unclip_ratio, bool use_dilation,
                              const std::string& score_mode,
-                             const std::string& box_type)
+                             const std::string& box_type,
+                             const std::string& box_extractor)
     : thresh_(thresh),
       box_thresh_(box_thresh),
       max_candidates_(max_candidates),
@@ -207,26 +420,125 @@ DBPostProcess::DBPostProcess(float thresh, float box_thresh, int max_candidates,
       min_size_(3),
       use_dilation_(use_dilation),
       score_mode_(score_mode),
-      box_type_(box_type) {
+      box_type_(box_type),
+      box_extractor_(box_extractor) {
   assert(score_mode == "slow" || score_mode == "fast");
   assert(box_type == "quad" || box_type == "poly");
+  assert(box_extractor == "contour" || box_extractor == "ccl");
+}
+
+absl::Status DBPostProcess::SetUnclipEngine(
+    const std::string& unclip_engine) {
+  if (unclip_engine != "clipper" && unclip_engine != "analytic") {
+    return absl::InvalidArgumentError(
+        "unclip_engine can only be one of ['clipper', 'analytic'], got " +
+        unclip_engine);
+  }
+  unclip_engine_ = unclip_engine;
+  return absl::OkStatus();
+}
+
+void DBPostProcess::SetThreadPool(
+    std::shared_ptr<PaddlePool::ThreadPool> pool, size_t min_chunk) {
+  pool_ = pool;
+  min_chunk_ = std::max<size_t>(min_chunk, 1);
+}
+
+void DBPostProcess::ForEachChunk(
+    size_t n, const std::function<void(size_t, size_t)>& func) const {
+  if (pool_ == nullptr || n <= min_chunk_) {
+    func(0, n);
+    return;
+  }
+  // A few chunks per thread so uneven candidates still balance.
+  size_t threads = std::max<size_t>(pool_->maxThreadsNum(), 1);
+  size_t chunk = std::max(min_chunk_, (n + 4 * threads - 1) / (4 * threads));
+  size_t chunks = (n + chunk - 1) / chunk;
+  PaddlePool::parallelFor(pool_.get(), chunks, threads,
+                          [&func, chunk, n](size_t c) {
+                            func(c * chunk, std::min(n, (c + 1) * chunk));
+                          });
+}
+
+std::pair<BoxStore, std::vector<float>>
+DBPostProcess::ExpandBoxes(
+    const std::vector<std::vector<cv::Point2f>>& candidates,
+    const std::vector<float>& candidate_scores, float box_thresh,
+    float unclip_ratio, int dest_width, int dest_height, float width_scale,
+    float height_scale) {
+  std::vector<cv::Point2f> expanded(4 * candidates.size());
+  std::vector<char> kept(candidates.size(), 0);
+  ForEachChunk(candidates.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      kept[i] = box_thresh <= candidate_scores[i] &&
+                ExpandBox(candidates[i], unclip_ratio, dest_width,
+                          dest_height, width_scale, height_scale,
+                          &expanded[4 * i]);
+    }
+  });
+
+  BoxStore boxes;
+  boxes.Reserve(candidates.size());
+  std::vector<float> scores;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (kept[i]) {
+      boxes.Add(&expanded[4 * i], 4);
+      scores.push_back(candidate_scores[i]);
+    }
+  }
+  return std::make_pair(std::move(boxes), std::move(scores));
+}
+
+absl::Status DBPostProcess::SetScoreEngine(const std::string& score_engine) {
+  if (score_engine != "mask" && score_engine != "integral") {
+    return absl::InvalidArgumentError(
+        "score_engine can only be one of ['mask', 'integral'], got " +
+        score_engine);
+  }
+  score_engine_ = score_engine;
+  return absl::OkStatus();
+}
+
+std::vector<float> DBPostProcess::ScoreBoxes(
+    const cv::Mat& pred,
+    const std::vector<std::vector<cv::Point2f>>& polygons, bool slow,
+    bool convex) {
+  std::vector<float> scores(polygons.size());
+  if (score_engine_ == "integral") {
+    if (!polygons.empty()) {
+      BoxScorer scorer(pred);
+      ForEachChunk(polygons.size(), [&](size_t begin, size_t end) {
+        scorer.PolygonMeans(polygons, convex, begin, end, scores.data());
+      });
+    }
+    return scores;
+  }
+  ForEachChunk(polygons.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      scores[i] = slow ? BoxScoreSlow(pred, polygons[i])
+                       : BoxScoreFast(pred, polygons[i]);
+    }
+  });
+  return scores;
 }
 
-absl::StatusOr<
-    std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
+absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
 DBPostProcess::operator()(const cv::Mat& preds,
                           const std::vector<int>& img_shapes,
                           absl::optional<float> thresh,
                           absl::optional<float> box_thresh,
                           absl::optional<float> unclip_ratio) {
-  std::vector<std::vector<cv::Point2f>> all_boxes;
+  BoxStore all_boxes;
   std::vector<float> all_scores;
   auto preds_batch = Utility::SplitBatch(preds);
   if (!preds_batch.ok()) {
     return preds_batch.status();
   }
+  DetShapeInfo shape_info;
+  shape_info.src_h = img_shapes[0];
+  shape_info.src_w = img_shapes[1];
   for (const auto& preds_data : *preds_batch) {
-    auto result = Process(preds_data, img_shapes, thresh.value_or(thresh_),
+    auto result = Process(preds_data, shape_info, thresh.value_or(thresh_),
                           box_thresh.value_or(box_thresh_),
                           unclip_ratio.value_or(unclip_ratio_));
 
@@ -234,53 +546,109 @@ DBPostProcess::operator()(const cv::Mat& preds,
       return result.status();
     }
 
-    auto boxes_result = *result;
-    auto boxes = boxes_result.first;
-    auto scores = boxes_result.second;
-    all_boxes.insert(all_boxes.end(), boxes.begin(), boxes.end());
-    all_scores.insert(all_scores.end(), scores.begin(), scores.end());
+    for (const auto& box : result->first) {
+      all_boxes.Add(box);
+    }
+    all_scores.insert(all_scores.end(), result->second.begin(),
+                      result->second.end());
   }
 
-  return std::make_pair(all_boxes, all_scores);
+  return std::make_pair(std::move(all_boxes), std::move(all_scores));
 }
 
-absl::StatusOr<std::vector<
-    std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>>
+absl::StatusOr<std::vector<std::pair<BoxStore, std::vector<float>>>>
 DBPostProcess::Apply(const cv::Mat& preds, const std::vector<int>& img_shapes,
                      absl::optional<float> thresh,
                      absl::optional<float> box_thresh,
                      absl::optional<float> unclip_ratio) {
-  std::vector<
-      std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
-      db_result = {};
+  if (preds.dims < 1) {
+    return absl::InvalidArgumentError("Prediction has no batch dimension.");
+  }
+  DetShapeInfo shape_info;
+  shape_info.src_h = img_shapes[0];
+  shape_info.src_w = img_shapes[1];
+  std::vector<DetShapeInfo> shape_infos(preds.size[0], shape_info);
+  return Apply(preds, shape_infos, thresh, box_thresh, unclip_ratio);
+}
+
+absl::StatusOr<std::vector<std::pair<BoxStore, std::vector<float>>>>
+DBPostProcess::Apply(const cv::Mat& preds,
+                     const std::vector<DetShapeInfo>& shape_infos,
+                     absl::optional<float> thresh,
+                     absl::optional<float> box_thresh,
+                     absl::optional<float> unclip_ratio) {
+  std::vector<std::pair<BoxStore, std::vector<float>>> db_result = {};
 
   auto preds_batch = Utility::SplitBatch(preds);
 
   if (!preds_batch.ok()) {
     return preds_batch.status();
   }
-  for (const auto& pred : preds_batch.value()) {
-    auto result = Process(pred, img_shapes, thresh.value_or(thresh_),
-                          box_thresh.value_or(box_thresh_),
-                          unclip_ratio.value_or(unclip_ratio_));
+  if (preds_batch.value().size() != shape_infos.size()) {
+    return absl::InvalidArgumentError(
+        "Got " + std::to_string(preds_batch.value().size()) +
+        " predictions but " + std::to_string(shape_infos.size()) +
+        " shapes.");
+  }
+  size_t batch = preds_batch.value().size();
+  std::vector<absl::StatusOr<std::pair<BoxStore, std::vector<float>>>>
+      results(batch);
+  auto process = [&](size_t i) {
+    results[i] = Process(preds_batch.value()[i], shape_infos[i],
+                         thresh.value_or(thresh_),
+                         box_thresh.value_or(box_thresh_),
+                         unclip_ratio.value_or(unclip_ratio_));
+  };
+  if (pool_ != nullptr && batch > 1) {
+    PaddlePool::parallelFor(pool_.get(), batch, batch, process);
+  } else {
+    for (size_t i = 0; i < batch; ++i) process(i);
+  }
 
+  for (auto& result : results) {
     if (!result.ok()) {
       return result.status();
     }
-    db_result.push_back(result.value());
+    db_result.push_back(std::move(result.value()));
   }
 
   return db_result;
 }
 
-absl::StatusOr<
-    std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
-DBPostProcess::Process(const cv::Mat& pred, const std::vector<int>& img_shape,
+absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
+DBPostProcess::Process(const cv::Mat& pred, const DetShapeInfo& shape_info,
                        float thresh, float box_thresh, float unclip_ratio) {
-  cv::Mat pred_single = pred.clone();
+  // Only read from here on, so a continuous map needs no copy.
+  cv::Mat pred_single = pred.isContinuous() ? pred : pred.clone();
   std::vector<int> shape_pred = {pred_single.size[pred_single.dims - 2],
                                  pred_single.size[pred_single.dims - 1]};
   pred_single = pred_single.reshape(1, shape_pred);
+  if (shape_info.resize_h > 0 && shape_info.resize_w > 0 &&
+      (shape_info.resize_h < pred_single.rows ||
+       shape_info.resize_w < pred_single.cols)) {
+    // Drop the canvas padding so boxes scale from the page alone.
+    pred_single = pred_single(cv::Rect(
+        0, 0, std::min(shape_info.resize_w, pred_single.cols),
+        std::min(shape_info.resize_h, pred_single.rows)));
+  }
+  int src_h = shape_info.src_h;
+  int src_w = shape_info.src_w;
+
+  if (box_type_ == "quad" && box_extractor_ == "ccl") {
+    cv::Mat mask(pred_single.rows, pred_single.cols, CV_8UC1);
+    for (int y = 0; y < pred_single.rows; ++y) {
+      SimdKernels::ThresholdToMask(pred_single.ptr<float>(y),
+                                   pred_single.cols, thresh,
+                                   mask.ptr<uint8_t>(y));
+    }
+    if (use_dilation_) {
+      cv::Mat kernel = (cv::Mat_<uchar>(2, 2) << 1, 1, 1, 1);
+      cv::dilate(mask, mask, kernel);
+    }
+    return BoxesFromComponents(pred_single, mask, src_w, src_h, box_thresh,
+                               unclip_ratio);
+  }
+
   cv::Mat segmentation = pred_single > thresh;
   cv::Mat mask;
   if (use_dilation_) {
@@ -290,9 +658,6 @@ DBPostProcess::Process(const cv::Mat& pred, const std::vector<int>& img_shape,
     mask = segmentation;
   }
 
-  int src_h = img_shape[0];
-  int src_w = img_shape[1];
-
   if (box_type_ == "poly") {
     return PolygonsFromBitmap(pred_single, mask, src_w, src_h, box_thresh,
                               unclip_ratio);
@@ -305,12 +670,11 @@ DBPostProcess::Process(const cv::Mat& pred, const std::vector<int>& img_shape,
       "box_type can only be one of ['quad', 'poly']");
 }
 
-absl::StatusOr<
-    std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
+absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
 DBPostProcess::PolygonsFromBitmap(const cv::Mat& pred, const cv::Mat& bitmap,
                                   int dest_width, int dest_height,
                                   float box_thresh, float unclip_ratio) {
-  std::vector<std::vector<cv::Point2f>> boxes;
+  BoxStore boxes;
   std::vector<float> scores;
 
   float width_scale = static_cast<float>(dest_width) / bitmap.cols;
@@ -326,6 +690,7 @@ DBPostProcess::PolygonsFromBitmap(const cv::Mat& pred, const cv::Mat& bitmap,
   int num_contours =
       std::min(static_cast<int>(contours.size()), max_candidates_);
 
+  std::vector<std::vector<cv::Point2f>> candidates;
   for (int i = 0; i < num_contours; ++i) {
     const auto& contour = contours[i];
 
@@ -336,8 +701,13 @@ DBPostProcess::PolygonsFromBitmap(const cv::Mat& pred, const cv::Mat& bitmap,
     if (approx.size() < 4) {
       continue;
     }
+    candidates.push_back(approx);
+  }
+  auto candidate_scores = ScoreBoxes(pred, candidates, false, false);
 
-    float score = BoxScoreFast(pred, approx);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    const auto& approx = candidates[i];
+    float score = candidate_scores[i];
     if (box_thresh > score) {
       continue;
     }
@@ -373,90 +743,278 @@ DBPostProcess::PolygonsFromBitmap(const cv::Mat& pred, const cv::Mat& bitmap,
                         dest_height - 1));
       }
 
-      boxes.push_back(box);
+      boxes.Add(box);
       scores.push_back(score);
     }
   }
 
-  return std::make_pair(boxes, scores);
+  return std::make_pair(std::move(boxes), std::move(scores));
 }
 
-absl::StatusOr<
-    std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
+absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
 DBPostProcess::BoxesFromBitmap(const cv::Mat& pred, const cv::Mat& bitmap,
                                int dest_width, int dest_height,
                                float box_thresh, float unclip_ratio) {
-  std::vector<std::vector<cv::Point2f>> boxes;
-  std::vector<float> scores;
-
   float width_scale = static_cast<float>(dest_width) / bitmap.cols;
   float height_scale = static_cast<float>(dest_height) / bitmap.rows;
 
-  cv::Mat bitmap_uint8;
-  bitmap.convertTo(bitmap_uint8, CV_8UC1, 255.0);
-
+  // pred > thresh is already 0/255.
   std::vector<std::vector<cv::Point>> contours_;
-  cv::findContours(bitmap_uint8, contours_, cv::RETR_LIST,
-                   cv::CHAIN_APPROX_SIMPLE);
+  cv::findContours(bitmap, contours_, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
   std::vector<std::vector<cv::Point2f>> contours;
-  for (const auto& contour : contours_) {  // 这里可以优化
-    std::vector<cv::Point2f> float_contour;
-    for (const auto& point : contour) {
-      float_contour.push_back(cv::Point2f(point.x, point.y));
-    }
-    contours.push_back(float_contour);
+  contours.reserve(contours_.size());
+  for (const auto& contour : contours_) {
+    contours.emplace_back(contour.begin(), contour.end());
   }
   int num_contours =
       std::min(static_cast<int>(contours.size()), max_candidates_);
 
+  bool slow = score_mode_ != "fast";
+  std::vector<std::pair<std::vector<cv::Point2f>, float>> mini_boxes(
+      num_contours);
+  ForEachChunk(num_contours, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      mini_boxes[i] = GetMiniBoxes(contours[i]);
+    }
+  });
+  std::vector<std::vector<cv::Point2f>> candidates;
+  std::vector<std::vector<cv::Point2f>> scored_polygons;
   for (int i = 0; i < num_contours; ++i) {
-    const auto& contour = contours[i];
-
-    auto contour_result = GetMiniBoxes(contour);
-    auto points = contour_result.first;
-    auto sside = contour_result.second;
-    if (sside < min_size_) {
+    if (mini_boxes[i].second < min_size_) {
       continue;
     }
+    candidates.push_back(mini_boxes[i].first);
+    scored_polygons.push_back(slow ? contours[i] : mini_boxes[i].first);
+  }
+  auto candidate_scores = ScoreBoxes(pred, scored_polygons, slow, !slow);
 
-    float score = 0;
-    if (score_mode_ == "fast") {
-      score = BoxScoreFast(pred, points);
-    } else {
-      score = BoxScoreSlow(pred, contour);
-    }
+  return ExpandBoxes(candidates, candidate_scores, box_thresh, unclip_ratio,
+                     dest_width, dest_height, width_scale, height_scale);
+}
 
-    if (box_thresh > score) {
-      continue;
+void DBPostProcess::OrderCorners(cv::Point2f corners[4]) {
+  std::sort(
+      corners, corners + 4,
+      [](const cv::Point2f& a, const cv::Point2f& b) { return a.x < b.x; });
+  cv::Point2f left_top = corners[1].y > corners[0].y ? corners[0] : corners[1];
+  cv::Point2f left_bottom =
+      corners[1].y > corners[0].y ? corners[1] : corners[0];
+  cv::Point2f right_top =
+      corners[3].y > corners[2].y ? corners[2] : corners[3];
+  cv::Point2f right_bottom =
+      corners[3].y > corners[2].y ? corners[3] : corners[2];
+  corners[0] = left_top;
+  corners[1] = right_top;
+  corners[2] = right_bottom;
+  corners[3] = left_bottom;
+}
+
+float DBPostProcess::UnclipRect(const std::vector<cv::Point2f>& box,
+                                float distance,
+                                cv::Point2f corners[4]) const {
+  if (box.size() != 4) {
+    return -1.0f;
+  }
+  cv::Point2f side_u = box[1] - box[0];
+  cv::Point2f side_v = box[3] - box[0];
+  float len_u = std::sqrt(side_u.dot(side_u));
+  float len_v = std::sqrt(side_v.dot(side_v));
+  if (len_u <= 0.0f || len_v <= 0.0f ||
+      std::abs(side_u.dot(side_v)) > 1e-3f * len_u * len_v) {
+    return -1.0f;
+  }
+  cv::Point2f u = side_u * (distance / len_u);
+  cv::Point2f v = side_v * (distance / len_v);
+  corners[0] = box[0] - u - v;
+  corners[1] = box[1] + u - v;
+  corners[2] = box[1] + side_v + u + v;
+  corners[3] = box[3] - u + v;
+  OrderCorners(corners);
+  return std::min(len_u, len_v) + 2.0f * distance;
+}
+
+bool DBPostProcess::ExpandBox(const std::vector<cv::Point2f>& points,
+                              float unclip_ratio, int dest_width,
+                              int dest_height, float width_scale,
+                              float height_scale, cv::Point2f box[4]) {
+  cv::Point2f corners[4];
+  float sside = -1.0f;
+  if (unclip_engine_ == "analytic") {
+    float length = cv::arcLength(points, true);
+    if (length > 0.0f) {
+      float distance = cv::contourArea(points) * unclip_ratio / length;
+      sside = UnclipRect(points, distance, corners);
     }
+  }
+  // Clipper also covers boxes that are not rectangles.
+  bool use_clipper = unclip_engine_ == "clipper" || sside < 0.0f;
+  bool kept = !use_clipper && sside >= min_size_ + 2;
 
+  if (use_clipper) {
     auto unclip_result = Unclip(points, unclip_ratio);
-    if (!unclip_result.ok()) {
-      continue;
+    if (unclip_result.ok()) {
+      auto min_box_result = GetMiniBoxes(*unclip_result);
+      kept = min_box_result.second >= min_size_ + 2;
+      if (kept) {
+        std::copy(min_box_result.first.begin(), min_box_result.first.end(),
+                  corners);
+      }
     }
+  }
+  if (!kept) {
+    return false;
+  }
 
-    auto box = *unclip_result;
-    auto min_box_result = GetMiniBoxes(box);
-    auto min_box = min_box_result.first;
-    auto new_sside = min_box_result.second;
-    if (new_sside < min_size_ + 2) {
-      continue;
+  for (int i = 0; i < 4; ++i) {
+    box[i].x = std::max(
+        0, std::min(static_cast<int>(std::round(corners[i].x * width_scale)),
+                    dest_width - 1));
+    box[i].y = std::max(
+        0, std::min(static_cast<int>(std::round(corners[i].y * height_scale)),
+                    dest_height - 1));
+  }
+  return true;
+}
+
+std::vector<DBPostProcess::Component> DBPostProcess::LabelComponents(
+    const cv::Mat& pred, const cv::Mat& mask) const {
+  struct Run {
+    int y;
+    int x0;
+    int x1;  // One past the last pixel.
+    double score_sum;
+  };
+  std::vector<Run> runs;
+  std::vector<int> parent;
+  auto find_root = [&parent](int i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+
+  // One sweep: split every row into runs, sum their scores and union them
+  // with the runs of the previous row they touch, diagonals included.
+  size_t prev_begin = 0, prev_end = 0;
+  for (int y = 0; y < mask.rows; ++y) {
+    const uint8_t* mask_row = mask.ptr<uint8_t>(y);
+    const float* pred_row = pred.ptr<float>(y);
+    size_t row_begin = runs.size();
+    size_t prev = prev_begin;
+    int x = 0;
+    while (x < mask.cols) {
+      if (mask_row[x] == 0) {
+        ++x;
+        continue;
+      }
+      Run run;
+      run.y = y;
+      run.x0 = x;
+      run.score_sum = 0.0;
+      for (; x < mask.cols && mask_row[x] != 0; ++x) {
+        run.score_sum += pred_row[x];
+      }
+      run.x1 = x;
+      int id = static_cast<int>(runs.size());
+      runs.push_back(run);
+      parent.push_back(id);
+      while (prev < prev_end && runs[prev].x1 < run.x0) ++prev;
+      for (size_t k = prev; k < prev_end && runs[k].x0 <= run.x1; ++k) {
+        int a = find_root(static_cast<int>(k));
+        int b = find_root(id);
+        // The lower run index stays root, so roots are first in raster order.
+        if (a < b) {
+          parent[b] = a;
+        } else if (b < a) {
+          parent[a] = b;
+        }
+      }
     }
+    prev_begin = row_begin;
+    prev_end = runs.size();
+  }
 
-    for (auto& point : min_box) {
-      point.x = std::max(
-          0, std::min(static_cast<int>(std::round(point.x * width_scale)),
-                      dest_width - 1));
-      point.y = std::max(
-          0, std::min(static_cast<int>(std::round(point.y * height_scale)),
-                      dest_height - 1));
+  std::vector<Component> components;
+  std::vector<int> component_of(runs.size(), -1);
+  for (size_t i = 0; i < runs.size(); ++i) {
+    int root = find_root(static_cast<int>(i));
+    if (component_of[root] < 0) {
+      component_of[root] = static_cast<int>(components.size());
+      components.emplace_back();
+      components.back().first_run = root;
     }
+    Component& component = components[component_of[root]];
+    component.area += runs[i].x1 - runs[i].x0;
+    component.score_sum += runs[i].score_sum;
+  }
 
-    boxes.push_back(min_box);
-    scores.push_back(score);
+  // Prune to the largest candidates before any geometry is built.
+  if (max_candidates_ >= 0 &&
+      components.size() > static_cast<size_t>(max_candidates_)) {
+    std::nth_element(components.begin(),
+                     components.begin() + max_candidates_, components.end(),
+                     [](const Component& a, const Component& b) {
+                       return a.area > b.area;
+                     });
+    components.resize(max_candidates_);
+    std::sort(components.begin(), components.end(),
+              [](const Component& a, const Component& b) {
+                return a.first_run < b.first_run;
+              });
+    std::fill(component_of.begin(), component_of.end(), -1);
+    for (size_t c = 0; c < components.size(); ++c) {
+      component_of[components[c].first_run] = static_cast<int>(c);
+    }
   }
 
-  return std::make_pair(boxes, scores);
+  for (size_t i = 0; i < runs.size(); ++i) {
+    int c = component_of[find_root(static_cast<int>(i))];
+    if (c < 0) {
+      continue;
+    }
+    auto& hull_points = components[c].hull_points;
+    hull_points.emplace_back(runs[i].x0, runs[i].y);
+    if (runs[i].x1 - 1 > runs[i].x0) {
+      hull_points.emplace_back(runs[i].x1 - 1, runs[i].y);
+    }
+  }
+  return components;
+}
+
+absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
+DBPostProcess::BoxesFromComponents(const cv::Mat& pred, const cv::Mat& mask,
+                                   int dest_width, int dest_height,
+                                   float box_thresh, float unclip_ratio) {
+  float width_scale = static_cast<float>(dest_width) / mask.cols;
+  float height_scale = static_cast<float>(dest_height) / mask.rows;
+
+  auto components = LabelComponents(pred, mask);
+  std::vector<std::pair<std::vector<cv::Point2f>, float>> mini_boxes(
+      components.size());
+  ForEachChunk(components.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      mini_boxes[i] = GetMiniBoxes(components[i].hull_points);
+    }
+  });
+  std::vector<std::vector<cv::Point2f>> candidates;
+  std::vector<float> candidate_scores;
+  for (size_t i = 0; i < components.size(); ++i) {
+    if (mini_boxes[i].second < min_size_) {
+      continue;
+    }
+    candidates.push_back(mini_boxes[i].first);
+    // The slow score is the mean over the region itself, summed while
+    // labeling. Unlike a filled contour it leaves holes out.
+    candidate_scores.push_back(static_cast<float>(
+        components[i].score_sum / components[i].area));
+  }
+  if (score_mode_ == "fast") {
+    candidate_scores = ScoreBoxes(pred, candidates, false, true);
+  }
+
+  return ExpandBoxes(candidates, candidate_scores, box_thresh, unclip_ratio,
+                     dest_width, dest_height, width_scale, height_scale);
 }
 
 absl::StatusOr<std::vector<cv::Point2f>> DBPostProcess::Unclip(
@@ -641,3 +1199,152 @@ float DBPostProcess::BoxScoreSlow(const cv::Mat& bitmap,
       bitmap(cv::Rect(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1)), mask);
   return static_cast<float>(mean[0]);
 }
+
+DetTiler::DetTiler(int tile_size, int overlap, int min_side,
+                   float merge_overlap)
+    : tile_size_(std::max(32, tile_size / 32 * 32)),
+      overlap_(std::max(0, std::min(overlap, tile_size_ / 2))),
+      min_side_(min_side),
+      merge_overlap_(merge_overlap) {}
+
+bool DetTiler::ShouldTile(const cv::Mat& img) const {
+  return std::max(img.rows, img.cols) > std::max(min_side_, tile_size_);
+}
+
+std::vector<cv::Rect> DetTiler::Tiles(int height, int width) const {
+  int stride = tile_size_ - overlap_;
+  auto starts = [this, stride](int length) -> std::vector<int> {
+    std::vector<int> result = {0};
+    while (result.back() + tile_size_ < length) {
+      result.push_back(std::min(result.back() + stride, length - tile_size_));
+    }
+    return result;
+  };
+  int tile_h = std::min(tile_size_, height);
+  int tile_w = std::min(tile_size_, width);
+  std::vector<cv::Rect> tiles;
+  for (int y : starts(height)) {
+    for (int x : starts(width)) {
+      tiles.emplace_back(x, y, tile_w, tile_h);
+    }
+  }
+  return tiles;
+}
+
+std::pair<BoxStore, std::vector<float>>
+DetTiler::Merge(
+    const std::vector<cv::Rect>& tiles,
+    const std::vector<std::pair<BoxStore, std::vector<float>>>& tile_results)
+    const {
+  BoxStore boxes;
+  std::vector<float> scores;
+  std::vector<cv::Rect2f> bounds;
+  std::vector<size_t> tile_begin = {0};
+  cv::Rect page;
+  std::vector<cv::Point2f> box;
+  for (size_t t = 0; t < tiles.size(); ++t) {
+    page |= tiles[t];
+    cv::Point2f offset(tiles[t].x, tiles[t].y);
+    for (size_t i = 0; i < tile_results[t].first.size(); ++i) {
+      box = tile_results[t].first[i].ToVector();
+      for (auto& point : box) {
+        point += offset;
+      }
+      bounds.push_back(cv::boundingRect(box));
+      boxes.Add(box);
+      scores.push_back(tile_results[t].second[i]);
+    }
+    tile_begin.push_back(boxes.size());
+  }
+
+  std::vector<size_t> parent(boxes.size());
+  for (size_t i = 0; i < parent.size(); ++i) {
+    parent[i] = i;
+  }
+  auto find = [&parent](size_t i) -> size_t {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+
+  // Both boxes of a pair lie inside the region their tiles share, so only
+  // that region is compared: a line cut at a seam covers it as fully as
+  // the whole line seen by the other tile does.
+  for (size_t a = 0; a < tiles.size(); ++a) {
+    for (size_t b = a + 1; b < tiles.size(); ++b) {
+      cv::Rect shared = tiles[a] & tiles[b];
+      if (shared.area() == 0) {
+        continue;
+      }
+      cv::Rect2f shared_f(shared);
+      cv::Point2f region[4] = {
+          shared_f.tl(), cv::Point2f(shared_f.br().x, shared_f.y),
+          shared_f.br(), cv::Point2f(shared_f.x, shared_f.br().y)};
+      auto in_region =
+          [&](size_t t) -> std::vector<std::pair<size_t, double>> {
+        std::vector<std::pair<size_t, double>> result;
+        for (size_t i = tile_begin[t]; i < tile_begin[t + 1]; ++i) {
+          if ((bounds[i] & shared_f).area() > 0) {
+            result.emplace_back(i, CropByPolys::IntersectionArea(
+                                       boxes[i], BoxView(region, 4)));
+          }
+        }
+        return result;
+      };
+      auto boxes_a = in_region(a);
+      auto boxes_b = in_region(b);
+      for (const auto& box_a : boxes_a) {
+        for (const auto& box_b : boxes_b) {
+          size_t i = box_a.first, j = box_b.first;
+          if ((bounds[i] & bounds[j]).area() <= 0 || find(i) == find(j)) {
+            continue;
+          }
+          double smaller = std::min(box_a.second, box_b.second);
+          if (smaller > 0 &&
+              CropByPolys::IntersectionArea(boxes[i], boxes[j]) >=
+                  merge_overlap_ * smaller) {
+            parent[find(j)] = find(i);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<size_t>> groups(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    groups[find(i)].push_back(i);
+  }
+  BoxStore merged_boxes;
+  merged_boxes.Reserve(boxes.size());
+  std::vector<float> merged_scores;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    const auto& group = groups[i];
+    if (group.size() == 1) {
+      merged_boxes.Add(boxes[i]);
+      merged_scores.push_back(scores[i]);
+    } else if (group.size() > 1) {
+      std::vector<cv::Point2f> points;
+      float score = 0.0f;
+      for (size_t member : group) {
+        points.insert(points.end(), boxes[member].begin(),
+                      boxes[member].end());
+        score = std::max(score, scores[member]);
+      }
+      cv::Point2f corners[4];
+      cv::minAreaRect(points).points(corners);
+      DBPostProcess::OrderCorners(corners);
+      for (auto& corner : corners) {
+        corner.x = std::max(0.0f, std::min(std::round(corner.x),
+                                           static_cast<float>(page.width - 1)));
+        corner.y = std::max(
+            0.0f, std::min(std::round(corner.y),
+                           static_cast<float>(page.height - 1)));
+      }
+      merged_boxes.Add(corners, 4);
+      merged_scores.push_back(score);
+    }
+  }
+  return std::make_pair(std::move(merged_boxes), std::move(merged_scores));
+}
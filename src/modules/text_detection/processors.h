@@ -14,7 +14,9 @@
 
 #pragma once
 
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <vector>
@@ -22,14 +24,31 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "polyclipping/clipper.hpp"
+#include "src/common/box_store.h"
+#include "src/common/thread_pool.h"
 #include "src/utils/func_register.h"
 
+// Where a page sits in the detector input. The resized page covers the top
+// left resize_h x resize_w of the input, the rest up to the canvas is
+// padding. A resize size of 0 means the page covers the whole input.
+struct DetShapeInfo {
+  int src_h = 0;
+  int src_w = 0;
+  int resize_h = 0;
+  int resize_w = 0;
+};
+
 struct DetResizeForTestParam {
   int limit_side_len = -1;
   std::string limit_type = std::string("");
   int max_side_limit = -1;
   std::vector<int> input_shape = {};
   std::vector<int> image_shape = {};
+  // When set, resized pages are snapped onto the smallest of these canvases
+  // they fit and padded, so mixed page sizes share a few input shapes.
+  std::vector<cv::Size> canvases = {};
+  // Receives one DetShapeInfo per image when not null.
+  std::vector<DetShapeInfo>* shape_info = nullptr;
 };
 
 class DetResizeForTest : public BaseProcessor {
@@ -42,6 +61,10 @@ class DetResizeForTest : public BaseProcessor {
       std::vector<cv::Mat>& input,
       const void* param_ptr = nullptr) const override;
 
+  // Parses canvases written as "WxH", both multiples of 32.
+  static absl::StatusOr<std::vector<cv::Size>> ParseCanvases(
+      const std::vector<std::string>& canvases);
+
  private:
   int resize_type_;
   bool keep_ratio_;
@@ -65,46 +88,161 @@ class DetResizeForTest : public BaseProcessor {
   absl::StatusOr<cv::Mat> ResizeImageType1(const cv::Mat& img) const;
   absl::StatusOr<cv::Mat> ResizeImageType2(const cv::Mat& img) const;
   absl::StatusOr<cv::Mat> ResizeImageType3(const cv::Mat& img) const;
+  // Pads `img` to the smallest canvas it fits, shrinking it first when it
+  // fits none. `info` gets the size the page ends up with.
+  cv::Mat SnapToCanvas(const cv::Mat& img,
+                       const std::vector<cv::Size>& canvases,
+                       DetShapeInfo& info) const;
   static constexpr int INPUTSHAPE = 3;
 };
 
+// Scores boxes against one probability map through its summed-area table.
+// The table is built once per map, after that a box costs one span sum per
+// row it covers and no allocation. Vertices are truncated to pixels like in
+// DBPostProcess::BoxScoreFast.
+class BoxScorer {
+ public:
+  explicit BoxScorer(const cv::Mat& pred);
+
+  // Mean of the pixels in rows y0..y1 and columns x0..x1, both inclusive.
+  float RectMean(int x0, int y0, int x1, int y1) const;
+  // Mean over `polygon`. Convex polygons count every pixel the polygon
+  // crosses, as fillPoly does; others count pixels whose center is inside.
+  float PolygonMean(const std::vector<cv::Point2f>& polygon,
+                    bool convex) const;
+  std::vector<float> PolygonMeans(
+      const std::vector<std::vector<cv::Point2f>>& polygons,
+      bool convex) const;
+  // Means of polygons[begin, end) written to means[begin, end).
+  void PolygonMeans(const std::vector<std::vector<cv::Point2f>>& polygons,
+                    bool convex, size_t begin, size_t end,
+                    float* means) const;
+
+ private:
+  // PolygonMean with caller owned scratch, so PolygonMeans allocates once.
+  float PolygonMean(const std::vector<cv::Point2f>& polygon, bool convex,
+                    std::vector<cv::Point2f>& points,
+                    std::vector<float>& crossings) const;
+  // Adds the sum and pixel count of row y, columns x0..x1, when not empty.
+  void AddSpan(int y, int x0, int x1, double& sum, int64_t& count) const;
+
+  cv::Mat integral_;  // (rows + 1) x (cols + 1), CV_64F.
+  int rows_;
+  int cols_;
+};
+
+// `box_extractor` picks how quad boxes are found: "contour" traces every
+// region with findContours, "ccl" labels connected components in one sweep
+// over the thresholded map and gathers what the boxes need on the way.
+// Poly boxes always use contours.
 class DBPostProcess {
  public:
   DBPostProcess(float thresh = 0.3f, float box_thresh = 0.7f,
                 int max_candidates = 1000, float unclip_ratio = 2.0f,
                 bool use_dilation = false,
                 const std::string& score_mode = "fast",
-                const std::string& box_type = "quad");
+                const std::string& box_type = "quad",
+                const std::string& box_extractor = "contour");
+
+  // `score_engine` is "mask", the fillPoly + cv::mean path, or "integral",
+  // which scores all boxes of a map through one BoxScorer.
+  // benchmark/box_score_bench.cc compares the two.
+  absl::Status SetScoreEngine(const std::string& score_engine);
+  // `unclip_engine` is "clipper", a round ClipperOffset reduced back to its
+  // min area rect, or "analytic", which grows quad boxes by the unclip
+  // distance on each side directly. Poly boxes always use Clipper.
+  // benchmark/unclip_bench.cc compares the two.
+  absl::Status SetUnclipEngine(const std::string& unclip_engine);
+  // Spreads batch items and chunks of at least `min_chunk` candidates over
+  // `pool`. Output order does not depend on it. Null runs on the caller.
+  void SetThreadPool(std::shared_ptr<PaddlePool::ThreadPool> pool,
+                     size_t min_chunk = 32);
+
+  // Orders four corners top left, top right, bottom right, bottom left the
+  // way GetMiniBoxes does.
+  static void OrderCorners(cv::Point2f corners[4]);
+
+  // An 8-connected region of the thresholded map. `hull_points` are the end
+  // pixels of every run, which span the same convex hull as the region.
+  struct Component {
+    int first_run = 0;
+    size_t area = 0;
+    double score_sum = 0.0;
+    std::vector<cv::Point2f> hull_points;
+  };
 
-  absl::StatusOr<
-      std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
+  // Labels the components of `mask` (0/1) run by run, keeping the
+  // max_candidates_ largest ones in raster order.
+  std::vector<Component> LabelComponents(const cv::Mat& pred,
+                                         const cv::Mat& mask) const;
+
+  absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
   operator()(const cv::Mat& preds, const std::vector<int>& img_shapes,
              absl::optional<float> thresh = absl::nullopt,
              absl::optional<float> box_thresh = absl::nullopt,
              absl::optional<float> unclip_ratio = absl::nullopt);
-  absl::StatusOr<std::vector<
-      std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>>
+  absl::StatusOr<std::vector<std::pair<BoxStore, std::vector<float>>>>
   Apply(const cv::Mat& preds, const std::vector<int>& img_shapes,
         absl::optional<float> thresh = absl::nullopt,
         absl::optional<float> box_thresh = absl::nullopt,
         absl::optional<float> unclip_ratio = absl::nullopt);
+  // One DetShapeInfo per image of `preds`. Padding outside each page is
+  // ignored and boxes are mapped back to the source size of their page.
+  absl::StatusOr<std::vector<std::pair<BoxStore, std::vector<float>>>>
+  Apply(const cv::Mat& preds, const std::vector<DetShapeInfo>& shape_infos,
+        absl::optional<float> thresh = absl::nullopt,
+        absl::optional<float> box_thresh = absl::nullopt,
+        absl::optional<float> unclip_ratio = absl::nullopt);
 
  private:
-  absl::StatusOr<
-      std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
-  Process(const cv::Mat& pred, const std::vector<int>& img_shape, float thresh,
+  absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
+  Process(const cv::Mat& pred, const DetShapeInfo& shape_info, float thresh,
           float box_thresh, float unclip_ratio);
 
-  absl::StatusOr<
-      std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
+  absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
   PolygonsFromBitmap(const cv::Mat& pred, const cv::Mat& bitmap, int dest_width,
                      int dest_height, float box_thresh, float unclip_ratio);
 
-  absl::StatusOr<
-      std::pair<std::vector<std::vector<cv::Point2f>>, std::vector<float>>>
+  absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
   BoxesFromBitmap(const cv::Mat& pred, const cv::Mat& bitmap, int dest_width,
                   int dest_height, float box_thresh, float unclip_ratio);
 
+  absl::StatusOr<std::pair<BoxStore, std::vector<float>>>
+  BoxesFromComponents(const cv::Mat& pred, const cv::Mat& mask,
+                      int dest_width, int dest_height, float box_thresh,
+                      float unclip_ratio);
+
+  // Scores every polygon of `pred`, with BoxScoreSlow when `slow` and with
+  // BoxScoreFast otherwise.
+  std::vector<float> ScoreBoxes(
+      const cv::Mat& pred,
+      const std::vector<std::vector<cv::Point2f>>& polygons, bool slow,
+      bool convex);
+
+  // Runs func(begin, end) over chunks of [0, n), on the pool if one is set.
+  void ForEachChunk(size_t n,
+                    const std::function<void(size_t, size_t)>& func) const;
+
+  // Expands the candidates scoring at least `box_thresh` and returns the
+  // kept boxes and scores in candidate order.
+  std::pair<BoxStore, std::vector<float>>
+  ExpandBoxes(const std::vector<std::vector<cv::Point2f>>& candidates,
+              const std::vector<float>& candidate_scores, float box_thresh,
+              float unclip_ratio, int dest_width, int dest_height,
+              float width_scale, float height_scale);
+
+  // Unclips a scored quad box, then maps it to the destination size and
+  // writes its four corners to `box`. Returns false when the box is dropped.
+  bool ExpandBox(const std::vector<cv::Point2f>& points, float unclip_ratio,
+                 int dest_width, int dest_height, float width_scale,
+                 float height_scale, cv::Point2f box[4]);
+
+  // The rectangle `box` grown by `distance` on every side, written to
+  // `corners` in GetMiniBoxes order. Returns the short side, or a negative
+  // value when `box` is not a rectangle.
+  float UnclipRect(const std::vector<cv::Point2f>& box, float distance,
+                   cv::Point2f corners[4]) const;
+
   absl::StatusOr<std::vector<cv::Point2f>> Unclip(
       const std::vector<cv::Point2f>& box, float unclip_ratio);
 
@@ -126,4 +264,46 @@ class DBPostProcess {
   bool use_dilation_;
   std::string score_mode_;
   std::string box_type_;
+  std::string box_extractor_;
+  std::string score_engine_ = "mask";
+
+  std::string unclip_engine_ = "clipper";
+
+  std::shared_ptr<PaddlePool::ThreadPool> pool_;
+  size_t min_chunk_ = 32;
+};
+
+// Splits pages too large for one detector run into overlapping tiles at
+// native resolution and merges the boxes found on each tile back into page
+// coordinates.
+class DetTiler {
+ public:
+  // Pages whose longer side exceeds `min_side` are cut into tiles of at most
+  // `tile_size` pixels a side that overlap by `overlap` pixels. Boxes from
+  // two tiles are merged when their intersection covers `merge_overlap` of
+  // the smaller of them, counted inside the region both tiles share.
+  DetTiler(int tile_size, int overlap, int min_side,
+           float merge_overlap = 0.5f);
+
+  bool ShouldTile(const cv::Mat& img) const;
+
+  // Tiles covering a `height` x `width` page in raster order. The last tile
+  // of a row or column is shifted back to end at the page border, so all
+  // tiles have the same size unless the page is smaller than a tile.
+  std::vector<cv::Rect> Tiles(int height, int width) const;
+
+  // `tile_results[i]` holds the boxes and scores found in `tiles[i]`, in
+  // tile coordinates. Boxes that do not meet another tile's box are kept
+  // as they are. Merged boxes become the min area rect of their group and
+  // keep its best score.
+  std::pair<BoxStore, std::vector<float>> Merge(
+      const std::vector<cv::Rect>& tiles,
+      const std::vector<std::pair<BoxStore, std::vector<float>>>& tile_results)
+      const;
+
+ private:
+  int tile_size_;
+  int overlap_;
+  int min_side_;
+  float merge_overlap_;
 };
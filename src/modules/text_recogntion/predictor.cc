@@ -15,6 +15,7 @@
 #include "predictor.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "result.h"
 #include "src/common/image_batch_sampler.h"
@@ -31,61 +32,121 @@ TextRecPredictor::TextRecPredictor(const std::string& model_dir,
                                    const TextRecPredictorParams& params)
     : BasePredictor(model_dir, params.device, params.precision,
                     params.enable_mkldnn, params.batch_size, params.config,
-                    "image"),
+                    "image", params.infer_backend, params.replay_dir),
       params_(params) {
   auto status = CheckRecModelParams();
   if (!status.ok()) {
     INFOE("Rec model params is invaild : %s", status.ToString().c_str());
     std::exit(-1);
   }
+  status = SetPipelineOption(params.pipeline_depth, params.pipeline_threads);
+  if (!status.ok()) {
+    INFOE("Rec pipeline option is invalid : %s", status.ToString().c_str());
+  }
   Build();
 };
 
+TextRecPredictor::~TextRecPredictor() {
+  if (batch_stats_.batches > 0) {
+    INFO("Rec batches: %zu of %.1f crops on average, %.1f%% filled, "
+         "%.1f%% padding",
+         batch_stats_.batches,
+         (double)batch_stats_.crops / batch_stats_.batches,
+         100.0 * batch_stats_.FillRatio(),
+         100.0 * batch_stats_.PaddingFraction());
+  }
+  if (cache_ == nullptr) {
+    return;
+  }
+  auto stats = cache_->GetStats();
+  if (stats.hits + stats.misses > 0) {
+    INFO("Rec cache: %llu hits, %llu misses (%.1f%% hit rate), %zu entries",
+         (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+         100.0 * stats.HitRate(), stats.entries);
+  }
+}
+
 void TextRecPredictor::Build() {
   const auto& pre_params = config_.PreProcessOpInfo();
   Register<ReadImage>("Read", "BGR");
-  Register<OCRReisizeNormImg>("ReisizeNorm");
+  RecWidthBuckets width_buckets(params_.width_bucket_step,
+                                params_.width_bucket_list);
+  std::vector<int> rec_image_shape = {3, 48, 320};
+  Register<OCRReisizeNormImg>("ReisizeNorm", rec_image_shape,
+                              std::vector<int>(), width_buckets);
   Register<ToBatch>("ToBatch");
+  quad_to_tensor_ = std::unique_ptr<OCRQuadToTensor>(
+      new OCRQuadToTensor(rec_image_shape, width_buckets));
 
-  infer_ptr_ = CreateStaticInfer();
+  auto infer = CreateStaticInfer();
+  if (!infer.ok()) {
+    INFOE("Create infer engine fail : %s", infer.status().ToString().c_str());
+    std::exit(-1);
+  }
+  infer_ptr_ = std::move(infer.value());
   const auto& post_params = config_.PostProcessOpInfo();
   post_op_["CTCLabelDecode"] = std::unique_ptr<CTCLabelDecode>(
       new CTCLabelDecode(YamlConfig::SmartParseVector(
                              post_params.at("PostProcess.character_dict"))
                              .vec_string));
+  if (params_.parallel_postprocess) {
+    // Every batch fans out on this pool, keep its workers between batches.
+    PaddlePool::ThreadPool::Options pool_options;
+    pool_options.fixed = true;
+    post_op_["CTCLabelDecode"]->SetThreadPool(PaddlePool::ThreadPool::shared(
+        std::max(PPOption().CpuThreads(), 1), pool_options));
+  }
+  if (params_.cache_capacity > 0) {
+    cache_ = std::unique_ptr<RecResultCache>(new RecResultCache(
+        params_.cache_capacity, std::max(params_.cache_shards, 1)));
+    cache_seed_ = RecResultCache::Seed(model_name_ + "@" + model_dir_);
+  }
 };
 
 std::vector<std::unique_ptr<BaseCVResult>> TextRecPredictor::Process(
     std::vector<cv::Mat>& batch_data) {
-  std::vector<cv::Mat> origin_image = {};
-  origin_image.reserve(batch_data.size());
+  return ProcessStages(batch_data);
+}
+
+absl::Status TextRecPredictor::Preprocess(std::vector<cv::Mat>& batch_data,
+                                          BaseBatchContext& context) {
+  context.origin_image.clear();
+  context.origin_image.reserve(batch_data.size());
   for (const auto& mat : batch_data) {
-    origin_image.push_back(mat.clone());
+    context.origin_image.push_back(mat.clone());
   }
   auto batch_read = pre_op_.at("Read")->Apply(batch_data);
   if (!batch_read.ok()) {
-    INFOE(batch_read.status().ToString().c_str());
+    return batch_read.status();
   }
 
   auto batch_resize_norm = pre_op_.at("ReisizeNorm")->Apply(batch_read.value());
   if (!batch_resize_norm.ok()) {
-    INFOE(batch_resize_norm.status().ToString().c_str());
+    return batch_resize_norm.status();
   }
 
   auto batch_tobatch = pre_op_.at("ToBatch")->Apply(batch_resize_norm.value());
   if (!batch_tobatch.ok()) {
-    INFOE(batch_tobatch.status().ToString().c_str());
+    return batch_tobatch.status();
   }
-  auto batch_infer = infer_ptr_->Apply(batch_tobatch.value());
+  context.batch_input = std::move(batch_tobatch.value());
+  return absl::OkStatus();
+}
+
+absl::Status TextRecPredictor::Infer(BaseBatchContext& context) {
+  auto batch_infer = infer_ptr_->Run(context.batch_input);
   if (!batch_infer.ok()) {
-    INFOE(batch_infer.status().ToString().c_str());
+    return batch_infer.status();
   }
+  return batch_infer.value()[0].CopyTo(context.infer_output);
+}
 
-  auto ctc_result =
-      post_op_.at("CTCLabelDecode")->Apply(batch_infer.value()[0]);
-
+std::vector<std::unique_ptr<BaseCVResult>> TextRecPredictor::Postprocess(
+    BaseBatchContext& context) {
+  auto ctc_result = post_op_.at("CTCLabelDecode")->Apply(context.infer_output);
   if (!ctc_result.ok()) {
     INFOE(ctc_result.status().ToString().c_str());
+    return {};
   }
 
   std::vector<std::unique_ptr<BaseCVResult>> base_cv_result_ptr_vec = {};
@@ -95,7 +156,7 @@ std::vector<std::unique_ptr<BaseCVResult>> TextRecPredictor::Process(
       if (input_index_ == input_path_.size()) input_index_ = 0;
       predictor_result.input_path = input_path_[input_index_];
     }
-    predictor_result.input_image = origin_image[i];
+    predictor_result.input_image = context.origin_image[i];
     predictor_result.rec_text = ctc_result.value()[i].first;
     predictor_result.rec_score = ctc_result.value()[i].second;
     predictor_result.vis_font = params_.vis_font_dir;
@@ -106,6 +167,167 @@ std::vector<std::unique_ptr<BaseCVResult>> TextRecPredictor::Process(
   return base_cv_result_ptr_vec;
 }
 
+std::vector<TextRecPredictorResult> TextRecPredictor::PredictQuads(
+    const cv::Mat& image, const BoxStore& quads,
+    const std::vector<int>& angles) {
+  return PredictQuads(std::vector<cv::Mat>(1, image),
+                      std::vector<int>(quads.size(), 0), quads, angles);
+}
+
+std::vector<TextRecPredictorResult> TextRecPredictor::PredictQuads(
+    const std::vector<cv::Mat>& images, const std::vector<int>& image_ids,
+    const BoxStore& quads, const std::vector<int>& angles) {
+  ResetResult();
+  input_path_.clear();
+  if (quads.size() != angles.size() || quads.size() != image_ids.size()) {
+    INFOE("Got %zu quads but %zu angles and %zu image ids", quads.size(),
+          angles.size(), image_ids.size());
+    return {};
+  }
+  std::vector<int> slot_widths(quads.size());
+  for (size_t i = 0; i < quads.size(); ++i) {
+    slot_widths[i] = SlotWidth(quads[i]);
+  }
+  // Made per call as SetBatchSize may change the count in between.
+  RecBatchPlanner planner(params_.batch_max_count > 0
+                              ? params_.batch_max_count
+                              : std::max(batch_size_, 1),
+                          params_.batch_width_budget,
+                          params_.batch_max_padding);
+  auto batches = planner.Plan(slot_widths);
+  std::vector<std::pair<std::string, float>> texts(quads.size());
+  auto status = RunStages(
+      batches.size(),
+      [&](size_t b, BaseBatchContext& context) {
+        return PrepareQuadBatch(images, image_ids, quads, angles, batches[b],
+                                texts.begin() + batches[b].first,
+                                static_cast<QuadBatchContext&>(context));
+      },
+      [&](size_t, BaseBatchContext& context) {
+        auto& quad_context = static_cast<QuadBatchContext&>(context);
+        batch_stats_.Add(quad_context.widths,
+                         quad_context.batch_input[0].size[3],
+                         planner.MaxCount(), planner.WidthBudget());
+        return quad_context.misses.empty() ? absl::OkStatus()
+                                           : Infer(quad_context);
+      },
+      [&](size_t b, BaseBatchContext& context) {
+        return DecodeQuadBatch(static_cast<QuadBatchContext&>(context),
+                               texts.begin() + batches[b].first);
+      });
+  if (!status.ok()) {
+    return {};
+  }
+  predictor_result_vec_.reserve(texts.size());
+  for (auto& text : texts) {
+    TextRecPredictorResult predictor_result;
+    predictor_result.rec_text = std::move(text.first);
+    predictor_result.rec_score = text.second;
+    predictor_result.vis_font = params_.vis_font_dir;
+    predictor_result_vec_.push_back(std::move(predictor_result));
+  }
+  return predictor_result_vec_;
+}
+
+absl::Status TextRecPredictor::PrepareQuadBatch(
+    const std::vector<cv::Mat>& images, const std::vector<int>& image_ids,
+    const BoxStore& quads, const std::vector<int>& angles,
+    std::pair<size_t, size_t> range,
+    std::vector<std::pair<std::string, float>>::iterator texts,
+    QuadBatchContext& context) const {
+  context.quads.Clear();
+  for (size_t i = range.first; i < range.second; ++i) {
+    context.quads.Add(quads[i]);
+  }
+  context.image_ids.assign(image_ids.begin() + range.first,
+                           image_ids.begin() + range.second);
+  context.angles.assign(angles.begin() + range.first,
+                        angles.begin() + range.second);
+  context.batch_input.resize(1);
+  auto status = quad_to_tensor_->Apply(images, context.image_ids,
+                                       context.quads, context.angles,
+                                       context.batch_input[0],
+                                       &context.widths);
+  if (!status.ok()) {
+    return status;
+  }
+  cv::Mat& batch = context.batch_input[0];
+  int count = batch.size[0];
+  int rec_h = batch.size[2];
+  int slot_w = batch.size[3];
+  size_t plane = (size_t)rec_h * slot_w;
+  size_t slot = 3 * plane;
+  float* data = batch.ptr<float>();
+
+  context.misses.clear();
+  if (cache_ == nullptr) {
+    for (int i = 0; i < count; ++i) {
+      context.misses.push_back(i);
+    }
+    return absl::OkStatus();
+  }
+  context.keys.resize(count);
+  for (int i = 0; i < count; ++i) {
+    context.keys[i] =
+        RecResultCache::TensorKey(data + i * slot, rec_h, context.widths[i],
+                                  slot_w, plane, cache_seed_);
+    if (!cache_->Lookup(context.keys[i], &texts[i])) {
+      context.misses.push_back(i);
+    }
+  }
+  // Missed slots move to the front and only they are decoded. misses[k]
+  // is never below k, so copying in order does not overwrite a later one.
+  // The whole batch is still inferred: a batch of just the misses would
+  // give every partial hit its own input shape and evict the planned
+  // shapes from the oneDNN cache.
+  for (size_t k = 0; k < context.misses.size(); ++k) {
+    if (context.misses[k] != (int)k) {
+      std::memcpy(data + k * slot, data + context.misses[k] * slot,
+                  slot * sizeof(float));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status TextRecPredictor::DecodeQuadBatch(
+    QuadBatchContext& context,
+    std::vector<std::pair<std::string, float>>::iterator texts) const {
+  int miss_count = (int)context.misses.size();
+  if (miss_count == 0) {
+    return absl::OkStatus();
+  }
+  cv::Mat preds = context.infer_output;
+  if (preds.dims < 1 || preds.size[0] != (int)context.quads.size()) {
+    return absl::InternalError("Rec output does not match its batch.");
+  }
+  if (miss_count < preds.size[0]) {
+    std::vector<cv::Range> ranges(preds.dims, cv::Range::all());
+    ranges[0] = cv::Range(0, miss_count);
+    preds = preds(ranges.data());
+  }
+  auto ctc_result = post_op_.at("CTCLabelDecode")->Apply(preds);
+  if (!ctc_result.ok()) {
+    return ctc_result.status();
+  }
+  if ((int)ctc_result.value().size() != miss_count) {
+    return absl::InternalError("Rec output does not match its batch.");
+  }
+  for (int k = 0; k < miss_count; ++k) {
+    if (cache_ != nullptr) {
+      cache_->Insert(context.keys[context.misses[k]], ctc_result.value()[k]);
+    }
+    texts[context.misses[k]] = std::move(ctc_result.value()[k]);
+  }
+  return absl::OkStatus();
+}
+
+RecResultCache::Stats TextRecPredictor::CacheStats() const {
+  if (cache_ == nullptr) {
+    return RecResultCache::Stats();
+  }
+  return cache_->GetStats();
+}
+
 absl::Status TextRecPredictor::CheckRecModelParams() {
   auto result_models_check =
       Utility::GetOcrModelInfo(params_.lang, params_.ocr_version);
@@ -15,6 +15,7 @@
 #pragma once
 
 #include "processors.h"
+#include "rec_cache.h"
 #include "src/base/base_batch_sampler.h"
 #include "src/base/base_cv_result.h"
 #include "src/base/base_predictor.h"
@@ -34,10 +35,42 @@ struct TextRecPredictorParams {
   bool enable_mkldnn = false;
   int batch_size = 1;
   std::unordered_map<std::string, std::string> config = {};
+  // Empty keeps the build default, see BasePredictor.
+  std::string infer_backend = "";
+  std::string replay_dir = "";
   std::string lang = "";
   std::string ocr_version = "";
   std::string vis_font_dir =
       "/workspace/cpp_infer_refactor/models/PP-OCRv5_server_rec/simfang.ttf";
+  int pipeline_depth = 0;
+  int pipeline_threads = 1;
+  // Input widths are padded up to these buckets, see RecWidthBuckets.
+  int width_bucket_step = 0;
+  std::vector<int> width_bucket_list = {};
+  // Decodes the sequences of a batch on the shared pool.
+  bool parallel_postprocess = false;
+  // Results of up to this many crops are cached by the content of their
+  // input tensor, see RecResultCache. 0 disables the cache.
+  int cache_capacity = 0;
+  int cache_shards = 16;
+  // Fused crop batches are packed by RecBatchPlanner: up to
+  // batch_max_count crops, batch_size if 0, within the width budget and
+  // padding share. A budget of 0 and padding of 1 pack by count only.
+  int batch_max_count = 0;
+  int batch_width_budget = 0;
+  float batch_max_padding = 1.0f;
+};
+
+// A PredictQuads batch between its stages: the quads it covers, the
+// widths they were resized to, and which slots missed the cache, moved to
+// the front of batch_input.
+struct QuadBatchContext : BaseBatchContext {
+  BoxStore quads;
+  std::vector<int> image_ids;
+  std::vector<int> angles;
+  std::vector<int> widths;
+  std::vector<uint64_t> keys;
+  std::vector<int> misses;
 };
 
 class TextRecPredictor : public BasePredictor {
@@ -49,6 +82,7 @@ class TextRecPredictor : public BasePredictor {
       const std::unordered_map<std::string, std::string> &config = {});
   TextRecPredictor(const std::string &model_dir,
                    const TextRecPredictorParams &params);
+  ~TextRecPredictor();
 
   std::vector<TextRecPredictorResult> PredictorResult() const {
     return predictor_result_vec_;
@@ -61,12 +95,65 @@ class TextRecPredictor : public BasePredictor {
   std::vector<std::unique_ptr<BaseCVResult>> Process(
       std::vector<cv::Mat> &batch_data) override;
 
+  std::unique_ptr<BaseBatchContext> CreateBatchContext() override {
+    return std::unique_ptr<BaseBatchContext>(new QuadBatchContext());
+  };
+  absl::Status Preprocess(std::vector<cv::Mat> &batch_data,
+                          BaseBatchContext &context) override;
+  absl::Status Infer(BaseBatchContext &context) override;
+  std::vector<std::unique_ptr<BaseCVResult>> Postprocess(
+      BaseBatchContext &context) override;
+
   absl::Status CheckRecModelParams();
 
+  // Recognizes `quads` of `image` without cropping them: each quad is warped
+  // straight into its slot of the batch tensor, turned upside down when its
+  // angle is 1. Results follow the order of `quads` and carry no
+  // input_image.
+  std::vector<TextRecPredictorResult> PredictQuads(
+      const cv::Mat &image, const BoxStore &quads,
+      const std::vector<int> &angles);
+  // As above with quads[i] taken from images[image_ids[i]]. Batches are
+  // filled in the order of `quads`, whatever page each quad is on, and go
+  // through the stages like those of Predict, so pipeline_depth overlaps
+  // their warping and decoding with inference.
+  std::vector<TextRecPredictorResult> PredictQuads(
+      const std::vector<cv::Mat> &images, const std::vector<int> &image_ids,
+      const BoxStore &quads, const std::vector<int> &angles);
+
+  // Padded width `quad` needs as the widest of a PredictQuads batch.
+  int SlotWidth(const BoxView &quad) const {
+    return quad_to_tensor_->SlotWidth(OCRQuadToTensor::CropRatio(quad));
+  };
+
+  // Zero while the cache is off.
+  RecResultCache::Stats CacheStats() const;
+  // Batches of PredictQuads since construction.
+  RecBatchStats BatchStats() const { return batch_stats_; };
+
  private:
+  // Warps quads[range) into context.batch_input and fills texts[i] of the
+  // crops found in the cache, texts pointing at the text of the first quad
+  // of the range. A batch of cached crops skips inference; a partly cached
+  // one is inferred whole, at its planned shape.
+  absl::Status PrepareQuadBatch(
+      const std::vector<cv::Mat> &images, const std::vector<int> &image_ids,
+      const BoxStore &quads, const std::vector<int> &angles,
+      std::pair<size_t, size_t> range,
+      std::vector<std::pair<std::string, float>>::iterator texts,
+      QuadBatchContext &context) const;
+  // Decodes the slots of `context` that missed the cache into their texts.
+  absl::Status DecodeQuadBatch(
+      QuadBatchContext &context,
+      std::vector<std::pair<std::string, float>>::iterator texts) const;
+
   std::unordered_map<std::string, std::unique_ptr<CTCLabelDecode>> post_op_;
   std::vector<TextRecPredictorResult> predictor_result_vec_;
-  std::unique_ptr<PaddleInfer> infer_ptr_;
+  std::unique_ptr<InferEngine> infer_ptr_;
+  std::unique_ptr<OCRQuadToTensor> quad_to_tensor_;
+  std::unique_ptr<RecResultCache> cache_;
+  uint64_t cache_seed_ = 0;
+  RecBatchStats batch_stats_;
   TextRecPredictorParams params_;
   int input_index_ = 0;
 };
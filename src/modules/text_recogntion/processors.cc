@@ -14,20 +14,45 @@
 
 #include "processors.h"
 
+#include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
 #include <unordered_map>
 
+#include "src/common/simd_kernels.h"
 #include "src/utils/utility.h"
 
+RecWidthBuckets::RecWidthBuckets(int step, std::vector<int> widths)
+    : step_(std::max(step, 0)), widths_(widths) {
+  std::sort(widths_.begin(), widths_.end());
+}
+
+int RecWidthBuckets::Fit(int width, int max_width) const {
+  auto bucket = std::lower_bound(widths_.begin(), widths_.end(), width);
+  if (bucket != widths_.end()) {
+    return std::min(*bucket, max_width);
+  }
+  if (step_ > 0) {
+    width = (width + step_ - 1) / step_ * step_;
+  }
+  return std::min(width, max_width);
+}
+
 absl::StatusOr<std::vector<cv::Mat>> OCRReisizeNormImg::Apply(
     std::vector<cv::Mat>& input, const void* param) const {
   std::vector<cv::Mat> output = {};
   output.reserve(input.size());
   if (input_shape_.empty()) {
+    float max_wh_ratio =
+        (float)rec_image_shape_[2] / (float)rec_image_shape_[1];
     for (auto& image : input) {
-      auto result = Resize(image);
+      max_wh_ratio =
+          std::max(max_wh_ratio, (float)image.size[1] / (float)image.size[0]);
+    }
+    for (auto& image : input) {
+      auto result = Resize(image, max_wh_ratio);
       if (!result.ok()) {
         return result.status();
       }
@@ -45,10 +70,8 @@ absl::StatusOr<std::vector<cv::Mat>> OCRReisizeNormImg::Apply(
   return output;
 }
 
-absl::StatusOr<cv::Mat> OCRReisizeNormImg::Resize(cv::Mat& image) const {
-  float rec_wh_ratio = (float)rec_image_shape_[2] / (float)rec_image_shape_[1];
-  float image_wh_ratio = (float)image.size[1] / (float)image.size[0];
-  float max_wh_ratio = std::max(rec_wh_ratio, image_wh_ratio);
+absl::StatusOr<cv::Mat> OCRReisizeNormImg::Resize(cv::Mat& image,
+                                                  float max_wh_ratio) const {
   auto image_result = ResizeNormImg(image, max_wh_ratio);
   if (!image_result.ok()) {
     return image_result.status();
@@ -115,6 +138,7 @@ absl::StatusOr<cv::Mat> OCRReisizeNormImg::ResizeNormImg(
   cv::hconcat(mat_split, resize_image_process);
   std::vector<int> resize_shape = {rec_c, rec_h, resize_w};
   resize_image_process = resize_image_process.reshape(1, resize_shape);
+  rec_w = width_buckets_.Fit(rec_w, MAX_IMG_W);
   std::vector<int> image_shape = {rec_c, rec_h, rec_w};
   cv::Mat padding_im =
       cv::Mat::zeros(image_shape.size(), &image_shape[0], CV_32F);
@@ -128,6 +152,200 @@ absl::StatusOr<cv::Mat> OCRReisizeNormImg::ResizeNormImg(
   return padding_im;
 }
 
+void RecBatchStats::Add(const std::vector<int>& widths, int slot_width,
+                        int max_count, int width_budget) {
+  ++batches;
+  crops += widths.size();
+  count_capacity += max_count;
+  width_capacity += width_budget;
+  for (int width : widths) {
+    content_width += width;
+  }
+  padded_width += (uint64_t)widths.size() * slot_width;
+}
+
+double RecBatchStats::FillRatio() const {
+  if (width_capacity > 0) {
+    return (double)padded_width / width_capacity;
+  }
+  return count_capacity > 0 ? (double)crops / count_capacity : 0.0;
+}
+
+double RecBatchStats::PaddingFraction() const {
+  return padded_width > 0 ? 1.0 - (double)content_width / padded_width : 0.0;
+}
+
+std::vector<std::pair<size_t, size_t>> RecBatchPlanner::Plan(
+    const std::vector<int>& slot_widths) const {
+  std::vector<std::pair<size_t, size_t>> batches;
+  size_t begin = 0;
+  uint64_t alone = 0;
+  int slot = 0;
+  for (size_t i = 0; i < slot_widths.size(); ++i) {
+    size_t count = i - begin + 1;
+    int grown_slot = std::max(slot, slot_widths[i]);
+    uint64_t grown_alone = alone + slot_widths[i];
+    uint64_t padded = (uint64_t)count * grown_slot;
+    bool fits = count <= (size_t)max_count_ &&
+                (width_budget_ == 0 || padded <= (uint64_t)width_budget_) &&
+                grown_alone >= (1.0 - max_padding_) * padded;
+    if (count > 1 && !fits) {
+      batches.emplace_back(begin, i);
+      begin = i;
+      grown_slot = slot_widths[i];
+      grown_alone = slot_widths[i];
+    }
+    slot = grown_slot;
+    alone = grown_alone;
+  }
+  if (begin < slot_widths.size()) {
+    batches.emplace_back(begin, slot_widths.size());
+  }
+  return batches;
+}
+
+namespace {
+
+// Crop size and orientation of CropByPolys::GetRotateCropImage for `quad`.
+struct QuadCrop {
+  int width;
+  int height;
+  bool rotate;  // Tall crops are turned 90 degrees clockwise.
+};
+
+QuadCrop GetQuadCrop(const BoxView& quad) {
+  float width = std::max(cv::norm(quad[0] - quad[1]),
+                         cv::norm(quad[2] - quad[3]));
+  float height = std::max(cv::norm(quad[0] - quad[3]),
+                          cv::norm(quad[1] - quad[2]));
+  QuadCrop crop;
+  crop.width = std::max((int)width, 1);
+  crop.height = std::max((int)height, 1);
+  crop.rotate = 1.0 * crop.height / crop.width >= 1.5;
+  return crop;
+}
+
+}  // namespace
+
+float OCRQuadToTensor::CropRatio(const BoxView& quad) {
+  QuadCrop crop = GetQuadCrop(quad);
+  return crop.rotate ? (float)crop.height / crop.width
+                     : (float)crop.width / crop.height;
+}
+
+int OCRQuadToTensor::ResizeLimit(float max_ratio) const {
+  float max_wh_ratio = std::max((float)rec_image_shape_[2] /
+                                    (float)rec_image_shape_[1],
+                                max_ratio);
+  return std::min((int)(rec_image_shape_[1] * max_wh_ratio),
+                  (int)OCRReisizeNormImg::MAX_IMG_W);
+}
+
+int OCRQuadToTensor::SlotWidth(float max_ratio) const {
+  return width_buckets_.Fit(ResizeLimit(max_ratio),
+                            OCRReisizeNormImg::MAX_IMG_W);
+}
+
+absl::Status OCRQuadToTensor::Apply(const cv::Mat& image,
+                                    const BoxStore& quads,
+                                    const std::vector<int>& angles,
+                                    cv::Mat& batch,
+                                    std::vector<int>* widths) const {
+  return Apply(std::vector<cv::Mat>(1, image),
+               std::vector<int>(quads.size(), 0), quads, angles, batch,
+               widths);
+}
+
+absl::Status OCRQuadToTensor::Apply(const std::vector<cv::Mat>& images,
+                                    const std::vector<int>& image_ids,
+                                    const BoxStore& quads,
+                                    const std::vector<int>& angles,
+                                    cv::Mat& batch,
+                                    std::vector<int>* widths) const {
+  for (const auto& image : images) {
+    if (image.empty() || image.type() != CV_8UC3) {
+      return absl::InvalidArgumentError(
+          "Input image must be 3 channel uint8.");
+    }
+  }
+  if (quads.empty() || quads.size() != angles.size() ||
+      quads.size() != image_ids.size()) {
+    return absl::InvalidArgumentError(
+        "Need one angle and image per quad and at least one quad.");
+  }
+  for (int id : image_ids) {
+    if (id < 0 || id >= (int)images.size()) {
+      return absl::InvalidArgumentError("Quad image id out of range.");
+    }
+  }
+  int rec_c = rec_image_shape_[0];
+  int rec_h = rec_image_shape_[1];
+  if (rec_c != 3) {
+    return absl::InvalidArgumentError("Only 3 channel inputs are supported.");
+  }
+  float max_ratio = 0.0f;
+  for (const auto& quad : quads) {
+    if (quad.size() != 4) {
+      return absl::InvalidArgumentError("Box must have 4 points.");
+    }
+    max_ratio = std::max(max_ratio, CropRatio(quad));
+  }
+  int resize_limit = ResizeLimit(max_ratio);
+  int slot_w = SlotWidth(max_ratio);
+  std::vector<int> batch_shape = {(int)quads.size(), rec_c, rec_h, slot_w};
+  batch.create(batch_shape.size(), batch_shape.data(), CV_32F);
+  batch.setTo(0);
+  if (widths != nullptr) {
+    widths->resize(quads.size());
+  }
+
+  // (x / 255 - 0.5) / 0.5, as in ResizeNormImg.
+  const float alpha[3] = {2.0f / 255.0f, 2.0f / 255.0f, 2.0f / 255.0f};
+  const float beta[3] = {-1.0f, -1.0f, -1.0f};
+  size_t plane = (size_t)rec_h * slot_w;
+  cv::Mat warped;
+  for (size_t i = 0; i < quads.size(); ++i) {
+    QuadCrop crop = GetQuadCrop(quads[i]);
+    cv::Point2f crop_corners[4] = {
+        cv::Point2f(0, 0), cv::Point2f(crop.width - 1, 0),
+        cv::Point2f(crop.width - 1, crop.height - 1),
+        cv::Point2f(0, crop.height - 1)};
+    cv::Mat to_crop =
+        cv::getPerspectiveTransform(quads[i].data(), crop_corners);
+
+    int crop_w = crop.rotate ? crop.height : crop.width;
+    int crop_h = crop.rotate ? crop.width : crop.height;
+    cv::Matx33d orient = cv::Matx33d::eye();
+    if (crop.rotate) {
+      orient = cv::Matx33d(0, -1, crop.height - 1, 1, 0, 0, 0, 0, 1);
+    }
+    if (angles[i] == 1) {
+      orient = cv::Matx33d(-1, 0, crop_w - 1, 0, -1, crop_h - 1, 0, 0, 1) *
+               orient;
+    }
+    int resize_w = std::min(
+        (int)std::ceil(rec_h * (float)crop_w / (float)crop_h), resize_limit);
+    resize_w = std::max(resize_w, 1);
+    if (widths != nullptr) {
+      (*widths)[i] = resize_w;
+    }
+    // Pixel centers map like in cv::resize.
+    double sx = (double)resize_w / crop_w;
+    double sy = (double)rec_h / crop_h;
+    cv::Matx33d scale(sx, 0, 0.5 * sx - 0.5, 0, sy, 0.5 * sy - 0.5, 0, 0, 1);
+    cv::Mat transform = cv::Mat(scale * orient) * to_crop;
+
+    cv::warpPerspective(images[image_ids[i]], warped, transform,
+                        cv::Size(resize_w, rec_h), cv::INTER_LINEAR,
+                        cv::BORDER_REPLICATE);
+    SimdKernels::NormalizeHWC3ToCHW(warped.ptr<uint8_t>(), warped.step[0],
+                                    rec_h, resize_w, alpha, beta,
+                                    batch.ptr<float>() + i * rec_c * plane,
+                                    slot_w, plane);
+  }
+  return absl::OkStatus();
+}
+
 CTCLabelDecode::CTCLabelDecode(const std::vector<std::string>& character_list,
                                bool use_space_char)
     : character_list_(character_list), use_space_char_(use_space_char) {
@@ -141,26 +359,36 @@ CTCLabelDecode::CTCLabelDecode(const std::vector<std::string>& character_list,
     character_list_.emplace_back(std::string(" "));
   }
   AddSpecialChar();
-  dict_.reserve(character_list_.size());
-  for (int i = 0; i < character_list_.size(); i++) {
-    dict_[i] = character_list_[i];
+  for (const auto& item : character_list_) {
+    max_char_bytes_ = std::max(max_char_bytes_, item.size());
   }
 }
 
 absl::StatusOr<std::vector<std::pair<std::string, float>>>
 CTCLabelDecode::Apply(const cv::Mat& preds) const {
   auto preds_batch = Utility::SplitBatch(preds);
-  std::vector<std::pair<std::string, float>> ctc_result = {};
-  ctc_result.reserve(preds_batch.value().size());
   if (!preds_batch.ok()) {
     return preds_batch.status();
   }
-  for (const auto& pred : preds_batch.value()) {
-    auto result = Process(pred);
+  const auto& batch = preds_batch.value();
+  std::vector<absl::StatusOr<std::pair<std::string, float>>> results(
+      batch.size());
+  auto process = [this, &batch, &results](size_t i) {
+    results[i] = Process(batch[i]);
+  };
+  if (pool_ != nullptr && batch.size() > 1) {
+    PaddlePool::parallelFor(pool_.get(), batch.size(), batch.size(), process);
+  } else {
+    for (size_t i = 0; i < batch.size(); ++i) process(i);
+  }
+
+  std::vector<std::pair<std::string, float>> ctc_result = {};
+  ctc_result.reserve(batch.size());
+  for (auto& result : results) {
     if (!result.ok()) {
       return result.status();
     }
-    ctc_result.push_back(result.value());
+    ctc_result.push_back(std::move(result.value()));
   }
   return ctc_result;
 }
@@ -176,86 +404,30 @@ absl::StatusOr<std::pair<std::string, float>> CTCLabelDecode::Process(
 
   int seq_len = pred_data_process.size[0];
   int num_classes = pred_data_process.size[1];
-  std::list<int> text_index;
-  std::list<float> text_prob;
-  for (int t = 0; t < seq_len; ++t) {
-    const float* row_ptr = pred_data_process.ptr<float>(t);
-    float max_val = row_ptr[0];
-    int max_idx = 0;
-    for (int c = 1; c < num_classes; ++c) {
-      if (row_ptr[c] > max_val) {
-        max_val = row_ptr[c];
-        max_idx = c;
-      }
-    }
-    text_index.push_back(max_idx);
-    text_prob.push_back(max_val);
-  }
-  auto decode_result = Decode(text_index, text_prob, true);
-  if (!decode_result.ok()) {
-    return decode_result.status();
-  }
-  return decode_result.value();
-}
-
-absl::StatusOr<std::pair<std::string, float>> CTCLabelDecode::Decode(
-    std::list<int>& text_index, std::list<float>& text_prob,
-    bool is_remove_duplicate) const {
-  std::vector<bool> selection(text_index.size(), true);
-  if (is_remove_duplicate && text_index.size() > 1) {
-    auto prev = text_index.begin();
-    auto curr = std::next(prev);
-    size_t idx = 1;
-    for (; curr != text_index.end(); ++curr, ++prev, ++idx) {
-      if (*curr == *prev) selection[idx] = false;
-    }
-  }
-  for (const auto& ignore_item : IGNORE_TOKEN) {
-    size_t idx = 0;
-    for (auto item_list = text_index.begin(); item_list != text_index.end();
-         ++item_list, idx++) {
-      if (*item_list == ignore_item) {
-        selection[idx] = false;
-      }
-    }
-  }
-  auto sel_it = selection.begin();
-  for (auto it = text_index.begin(); it != text_index.end();) {
-    if (!(*sel_it)) {
-      it = text_index.erase(it);
-    } else {
-      ++it;
-    }
-    ++sel_it;
-  }
-  auto sel_it_prob = selection.begin();
-  for (auto it = text_prob.begin(); it != text_prob.end();) {
-    if (!(*sel_it_prob)) {
-      it = text_prob.erase(it);
-    } else {
-      ++it;
-    }
-    ++sel_it_prob;
-  }
-  std::vector<std::string> char_list = {};
-  for (auto list_index = text_index.begin(); list_index != text_index.end();
-       ++list_index) {
-    char_list.push_back(character_list_[*list_index]);
-  }
-  std::list<float> conf_list = {};
-  if (!text_prob.empty()) {
-    conf_list = text_prob;
-  } else {
-    conf_list = std::list<float>(selection.size(), 0);
+  if (num_classes > static_cast<int>(character_list_.size())) {
+    return absl::InvalidArgumentError(
+        "CTC output has " + std::to_string(num_classes) +
+        " classes but the dictionary only " +
+        std::to_string(character_list_.size()));
   }
   std::string text;
-  for (const auto& item_char : char_list) {
-    text += item_char;
+  text.reserve(seq_len * max_char_bytes_);
+  float conf_sum = 0.0f;
+  int kept = 0;
+  int prev = -1;
+  for (int t = 0; t < seq_len; ++t) {
+    float max_val;
+    int max_idx = SimdKernels::ArgMax(pred_data_process.ptr<float>(t),
+                                      num_classes, &max_val);
+    if (max_idx != prev && max_idx != IGNORE_TOKEN) {
+      text += character_list_[max_idx];
+      conf_sum += max_val;
+      ++kept;
+    }
+    prev = max_idx;
   }
-  float sum = std::accumulate(conf_list.begin(), conf_list.end(), 0.0f);
-  float mean = sum / conf_list.size();
-
-  return std::pair<std::string, float>(text, mean);
+  float mean = kept > 0 ? conf_sum / kept : 0.0f;
+  return std::pair<std::string, float>(std::move(text), mean);
 }
 
 void CTCLabelDecode::AddSpecialChar() {
@@ -14,22 +14,97 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "src/common/box_store.h"
+#include "src/common/thread_pool.h"
 #include "src/utils/func_register.h"
 
+// Rounds recognition input widths up to a small set of widths. Every new
+// input shape costs a fresh set of oneDNN primitives, so padding crops to a
+// few bucket widths keeps the primitive cache warm. Widths are matched
+// against the sorted `widths` list first and rounded up to a multiple of
+// `step` past its end; with neither set widths are left alone.
+class RecWidthBuckets {
+ public:
+  RecWidthBuckets(int step = 0, std::vector<int> widths = {});
+
+  // Smallest bucket holding `width`, never above `max_width`.
+  int Fit(int width, int max_width) const;
+
+ private:
+  int step_;
+  std::vector<int> widths_;
+};
+
+// Running totals over recognition batches, to tune RecBatchPlanner.
+struct RecBatchStats {
+  size_t batches = 0;
+  size_t crops = 0;
+  // Sums of batch capacities, the width budget only when one is set.
+  size_t count_capacity = 0;
+  uint64_t width_capacity = 0;
+  // Resized crop widths and crop count times slot width, summed.
+  uint64_t content_width = 0;
+  uint64_t padded_width = 0;
+
+  void Add(const std::vector<int>& widths, int slot_width, int max_count,
+           int width_budget);
+  // Used share of the batch capacity, by width if budgeted.
+  double FillRatio() const;
+  // Share of the inferred pixels that were padding.
+  double PaddingFraction() const;
+};
+
+// Splits a run of crops into recognition batches. A batch takes crops in
+// order until one more would exceed `max_count` crops, push the batch
+// width, its crop count times its slot width, past `width_budget`, or make
+// more than `max_padding` of that width padding added by batching, i.e.
+// beyond the slots the crops would get alone. A crop always fits into an
+// empty batch. A budget of 0 and a max_padding of 1 disable those limits,
+// leaving batches of `max_count`.
+class RecBatchPlanner {
+ public:
+  RecBatchPlanner(int max_count = 1, int width_budget = 0,
+                  float max_padding = 1.0f)
+      : max_count_(std::max(max_count, 1)),
+        width_budget_(std::max(width_budget, 0)),
+        max_padding_(max_padding){};
+
+  // slot_widths[i] is the padded width of crop i alone, as the widest of a
+  // batch. Returns [begin, end) ranges.
+  std::vector<std::pair<size_t, size_t>> Plan(
+      const std::vector<int>& slot_widths) const;
+
+  int MaxCount() const { return max_count_; };
+  int WidthBudget() const { return width_budget_; };
+
+ private:
+  int max_count_;
+  int width_budget_;
+  float max_padding_;
+};
+
 class OCRReisizeNormImg : public BaseProcessor {
  public:
   OCRReisizeNormImg(std::vector<int> rec_image_shape = {3, 48, 320},
-                    std::vector<int> input_shape = {})
-      : rec_image_shape_(rec_image_shape), input_shape_(input_shape){};
+                    std::vector<int> input_shape = {},
+                    RecWidthBuckets width_buckets = RecWidthBuckets())
+      : rec_image_shape_(rec_image_shape),
+        input_shape_(input_shape),
+        width_buckets_(width_buckets){};
+  // Images of one call share the width of the widest one, so the output can
+  // be stacked by ToBatch.
   absl::StatusOr<std::vector<cv::Mat>> Apply(
       std::vector<cv::Mat>& input, const void* param = nullptr) const override;
-  absl::StatusOr<cv::Mat> Resize(cv::Mat& image) const;
+  absl::StatusOr<cv::Mat> Resize(cv::Mat& image, float max_wh_ratio) const;
   absl::StatusOr<cv::Mat> StaticResize(cv::Mat& image) const;
   absl::StatusOr<cv::Mat> ResizeNormImg(cv::Mat& image,
                                         float max_wh_ratio) const;
@@ -38,8 +113,51 @@ class OCRReisizeNormImg : public BaseProcessor {
  private:
   std::vector<int> rec_image_shape_;
   std::vector<int> input_shape_;
+  RecWidthBuckets width_buckets_;
+};
+
+// Maps text quads of a page straight into their padded slots of a 3 x H x W
+// recognition batch. Crop, 90 degree turn of tall boxes, 180 degree flip,
+// resize to height H and normalization are composed into one
+// warpPerspective per quad, so no full resolution crop is ever made. This
+// replaces CropByPolys + RotateImage + OCRReisizeNormImg + ToBatch.
+class OCRQuadToTensor {
+ public:
+  OCRQuadToTensor(std::vector<int> rec_image_shape = {3, 48, 320},
+                  RecWidthBuckets width_buckets = RecWidthBuckets())
+      : rec_image_shape_(rec_image_shape), width_buckets_(width_buckets){};
+
+  // Width over height of the crop CropByPolys would make of `quad`.
+  static float CropRatio(const BoxView& quad);
+  // Padded width of a batch whose widest quad has CropRatio `max_ratio`.
+  int SlotWidth(float max_ratio) const;
+
+  // quads[i] lands in slot i of `batch`, turned upside down if angles[i] is
+  // 1. `batch` becomes N x 3 x H x W with W fitting the widest quad, its
+  // buffer is reused when the shape does not change. The width each quad
+  // was resized to, before padding, goes to `widths` if given.
+  absl::Status Apply(const cv::Mat& image, const BoxStore& quads,
+                     const std::vector<int>& angles, cv::Mat& batch,
+                     std::vector<int>* widths = nullptr) const;
+  // As above with quads[i] taken from images[image_ids[i]], so one batch
+  // can hold the text of several pages.
+  absl::Status Apply(const std::vector<cv::Mat>& images,
+                     const std::vector<int>& image_ids, const BoxStore& quads,
+                     const std::vector<int>& angles, cv::Mat& batch,
+                     std::vector<int>* widths = nullptr) const;
+
+ private:
+  // Slot width before bucketing, which also caps the content widths.
+  int ResizeLimit(float max_ratio) const;
+
+  std::vector<int> rec_image_shape_;
+  RecWidthBuckets width_buckets_;
 };
 
+// Greedy CTC decoding. Each timestep takes the argmax class, repeats of the
+// previous timestep and the blank are dropped and the kept classes are
+// appended to the text while their probabilities are summed for the score,
+// all in one pass over the sequence.
 class CTCLabelDecode {
  public:
   CTCLabelDecode(const std::vector<std::string>& character_list = {},
@@ -48,15 +166,18 @@ class CTCLabelDecode {
       const cv::Mat& preds) const;
   absl::StatusOr<std::pair<std::string, float>> Process(
       const cv::Mat& pred_data) const;
-  absl::StatusOr<std::pair<std::string, float>> Decode(
-      std::list<int>& text_index, std::list<float>& text_prob,
-      bool is_remove_duplicate = false) const;
   void AddSpecialChar();
+  // Decodes the sequences of a batch on `pool`. Null runs on the caller.
+  void SetThreadPool(std::shared_ptr<PaddlePool::ThreadPool> pool) {
+    pool_ = pool;
+  };
 
  private:
   std::vector<std::string> character_list_;
   bool use_space_char_;
-  std::unordered_map<int, std::string> dict_;
+  // Longest entry of character_list_ in bytes, to size the text up front.
+  size_t max_char_bytes_ = 1;
+  std::shared_ptr<PaddlePool::ThreadPool> pool_;
 
-  const std::vector<int> IGNORE_TOKEN = {0};
+  static constexpr int IGNORE_TOKEN = 0;
 };
@@ -0,0 +1,130 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rec_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kMul1 = 0x9E3779B97F4A7C15ULL;
+constexpr uint64_t kMul2 = 0xC2B2AE3D27D4EB4FULL;
+
+// Final mix of MurmurHash3, spreads every input bit over the whole key.
+uint64_t Finalize(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+uint64_t Combine(uint64_t h, uint64_t word) {
+  word *= kMul2;
+  word = (word << 31) | (word >> 33);
+  h ^= word * kMul1;
+  return ((h << 27) | (h >> 37)) * 5 + 0x52DCE729;
+}
+
+uint64_t HashBytes(const char* data, size_t size, uint64_t h) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    h = Combine(h, word);
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    std::memcpy(&word, data + i, size - i);
+    h = Combine(h, word);
+  }
+  return h;
+}
+
+}  // namespace
+
+RecResultCache::RecResultCache(size_t capacity, size_t shards)
+    : shards_(std::max<size_t>(std::min(shards, capacity), 1)),
+      hits_(0),
+      misses_(0) {
+  shard_capacity_ = std::max<size_t>(capacity / shards_.size(), 1);
+}
+
+bool RecResultCache::Lookup(uint64_t key,
+                            std::pair<std::string, float>* result) {
+  Shard& shard = ShardOf(key);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+      *result = it->second->second;
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void RecResultCache::Insert(uint64_t key,
+                            const std::pair<std::string, float>& result) {
+  Shard& shard = ShardOf(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    it->second->second = result;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return;
+  }
+  if (shard.index.size() >= shard_capacity_) {
+    shard.index.erase(shard.lru.back().first);
+    shard.lru.pop_back();
+  }
+  shard.lru.emplace_front(key, result);
+  shard.index[key] = shard.lru.begin();
+}
+
+RecResultCache::Stats RecResultCache::GetStats() const {
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    stats.entries += shard.index.size();
+  }
+  return stats;
+}
+
+uint64_t RecResultCache::TensorKey(const float* data, int height, int width,
+                                   size_t row_stride, size_t plane,
+                                   uint64_t seed) {
+  uint64_t h = Combine(seed, (static_cast<uint64_t>(height) << 32) |
+                                 static_cast<uint32_t>(width));
+  for (int c = 0; c < 3; ++c) {
+    const float* rows = data + c * plane;
+    for (int y = 0; y < height; ++y) {
+      h = HashBytes(reinterpret_cast<const char*>(rows + y * row_stride),
+                    width * sizeof(float), h);
+    }
+  }
+  return Finalize(h);
+}
+
+uint64_t RecResultCache::Seed(const std::string& model_identity) {
+  return Finalize(HashBytes(model_identity.data(), model_identity.size(),
+                            kMul1));
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Bounded LRU map from a 64 bit crop key to its recognized text and score.
+// Keys are spread over shards with their own lock and LRU list, so
+// concurrent recognizers rarely wait on each other. Each shard keeps up to
+// capacity / shards entries.
+class RecResultCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t entries = 0;
+    double HitRate() const {
+      uint64_t lookups = hits + misses;
+      return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+    };
+  };
+
+  explicit RecResultCache(size_t capacity, size_t shards = 16);
+
+  RecResultCache(const RecResultCache&) = delete;
+  RecResultCache& operator=(const RecResultCache&) = delete;
+
+  // Fills `result` and marks the entry most recently used on a hit.
+  bool Lookup(uint64_t key, std::pair<std::string, float>* result);
+  void Insert(uint64_t key, const std::pair<std::string, float>& result);
+  Stats GetStats() const;
+
+  // Key of a 3 x `height` x `width` float tensor whose rows are
+  // `row_stride` floats apart and whose planes are `plane` floats apart.
+  // `seed` tells models apart, see Seed. Equal keys of different tensors
+  // are possible but as unlikely as for any 64 bit hash.
+  static uint64_t TensorKey(const float* data, int height, int width,
+                            size_t row_stride, size_t plane, uint64_t seed);
+  static uint64_t Seed(const std::string& model_identity);
+
+ private:
+  using Entry = std::pair<uint64_t, std::pair<std::string, float>>;
+  struct Shard {
+    mutable std::mutex mutex;
+    // Most recently used first.
+    std::list<Entry> lru;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+  };
+
+  Shard& ShardOf(uint64_t key) { return shards_[key % shards_.size()]; };
+
+  std::vector<Shard> shards_;
+  size_t shard_capacity_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+};
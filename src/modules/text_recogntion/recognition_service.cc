@@ -0,0 +1,287 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "recognition_service.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+std::mutex RecognitionService::shared_mutex_;
+std::unordered_map<std::string, std::weak_ptr<RecognitionService>>
+    RecognitionService::shared_services_;
+
+namespace {
+
+class PredictorRecognizer : public QuadRecognizer {
+ public:
+  PredictorRecognizer(const std::string& model_dir,
+                      const TextRecPredictorParams& params)
+      : predictor_(model_dir, params){};
+
+  int SlotWidth(const BoxView& quad) const override {
+    return predictor_.SlotWidth(quad);
+  };
+  std::vector<TextRecPredictorResult> PredictQuads(
+      const std::vector<cv::Mat>& pages, const std::vector<int>& page_ids,
+      const BoxStore& quads, const std::vector<int>& angles) override {
+    return predictor_.PredictQuads(pages, page_ids, quads, angles);
+  };
+
+ private:
+  TextRecPredictor predictor_;
+};
+
+}  // namespace
+
+std::vector<std::unique_ptr<QuadRecognizer>>
+RecognitionService::MakeRecognizers(const std::string& model_dir,
+                                    const TextRecPredictorParams& params,
+                                    const Options& options) {
+  // Batches arrive planned, the recognizers must not split them again.
+  TextRecPredictorParams context_params = params;
+  context_params.batch_max_count =
+      RecBatchPlanner(options.max_batch).MaxCount();
+  context_params.batch_width_budget = std::max(options.width_budget, 0);
+  context_params.batch_max_padding = options.max_padding;
+  std::vector<std::unique_ptr<QuadRecognizer>> recognizers;
+  for (int i = 0; i < std::max(options.contexts, 1); ++i) {
+    recognizers.push_back(std::unique_ptr<QuadRecognizer>(
+        new PredictorRecognizer(model_dir, context_params)));
+  }
+  return recognizers;
+}
+
+RecognitionService::RecognitionService(const std::string& model_dir,
+                                       const TextRecPredictorParams& params,
+                                       const Options& options)
+    : RecognitionService(MakeRecognizers(model_dir, params, options),
+                         options) {}
+
+RecognitionService::RecognitionService(
+    std::vector<std::unique_ptr<QuadRecognizer>> recognizers,
+    const Options& options)
+    : options_(options),
+      planner_(options.max_batch, options.width_budget, options.max_padding),
+      recognizers_(std::move(recognizers)) {
+  options_.contexts = static_cast<int>(recognizers_.size());
+  options_.max_wait_us = std::max(options_.max_wait_us, 0);
+  batcher_ = std::thread(&RecognitionService::BatchLoop, this);
+  for (size_t i = 0; i < recognizers_.size(); ++i) {
+    workers_.emplace_back(&RecognitionService::WorkerLoop, this, i);
+  }
+}
+
+RecognitionService::~RecognitionService() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_batcher_ = true;
+  }
+  pending_cv_.notify_all();
+  taken_cv_.notify_all();
+  batcher_.join();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_workers_ = true;
+  }
+  batch_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::future<std::vector<TextRecPredictorResult>> RecognitionService::Submit(
+    const std::vector<cv::Mat>& pages, const std::vector<int>& page_ids,
+    const BoxStore& quads, const std::vector<int>& angles) {
+  auto request = std::make_shared<Request>();
+  auto future = request->promise.get_future();
+  if (quads.size() != page_ids.size() || quads.size() != angles.size()) {
+    INFOE("Got %zu quads but %zu page ids and %zu angles", quads.size(),
+          page_ids.size(), angles.size());
+    request->promise.set_value({});
+    return future;
+  }
+  if (quads.empty()) {
+    request->promise.set_value({});
+    return future;
+  }
+  request->pages = pages;
+  request->page_ids = page_ids;
+  request->quads = quads;
+  request->angles = angles;
+  request->results.resize(quads.size());
+  request->remaining = quads.size();
+
+  std::vector<Crop> crops(quads.size());
+  auto now = Clock::now();
+  for (size_t i = 0; i < quads.size(); ++i) {
+    crops[i].request = request;
+    crops[i].index = i;
+    crops[i].slot_width = recognizers_[0]->SlotWidth(quads[i]);
+    crops[i].arrival = now;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& crop : crops) {
+      pending_max_slot_ = std::max(pending_max_slot_, crop.slot_width);
+      pending_.push_back(std::move(crop));
+    }
+  }
+  pending_cv_.notify_one();
+  return future;
+}
+
+bool RecognitionService::PendingFull() const {
+  if (pending_.size() >= (size_t)planner_.MaxCount()) {
+    return true;
+  }
+  return planner_.WidthBudget() > 0 &&
+         pending_.size() * pending_max_slot_ >=
+             (size_t)planner_.WidthBudget();
+}
+
+void RecognitionService::BatchLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    pending_cv_.wait(lock,
+                     [this]() { return stop_batcher_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      return;
+    }
+    auto deadline = pending_.front().arrival +
+                    std::chrono::microseconds(options_.max_wait_us);
+    pending_cv_.wait_until(lock, deadline, [this]() {
+      return stop_batcher_ || PendingFull();
+    });
+    taken_cv_.wait(lock, [this]() {
+      return stop_batcher_ || batches_.size() < recognizers_.size();
+    });
+
+    std::vector<Crop> crops(std::make_move_iterator(pending_.begin()),
+                            std::make_move_iterator(pending_.end()));
+    pending_.clear();
+    pending_max_slot_ = 0;
+    std::stable_sort(crops.begin(), crops.end(),
+                     [](const Crop& a, const Crop& b) {
+                       return a.slot_width < b.slot_width;
+                     });
+    std::vector<int> slot_widths;
+    slot_widths.reserve(crops.size());
+    for (const auto& crop : crops) {
+      slot_widths.push_back(crop.slot_width);
+    }
+    for (const auto& range : planner_.Plan(slot_widths)) {
+      batches_.emplace_back(
+          std::make_move_iterator(crops.begin() + range.first),
+          std::make_move_iterator(crops.begin() + range.second));
+    }
+    batch_cv_.notify_all();
+  }
+}
+
+void RecognitionService::WorkerLoop(size_t context) {
+  while (true) {
+    Batch batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      batch_cv_.wait(lock,
+                     [this]() { return stop_workers_ || !batches_.empty(); });
+      if (batches_.empty()) {
+        return;
+      }
+      batch = std::move(batches_.front());
+      batches_.pop_front();
+    }
+    taken_cv_.notify_one();
+    RunBatch(*recognizers_[context], batch);
+  }
+}
+
+void RecognitionService::RunBatch(QuadRecognizer& recognizer,
+                                  const Batch& batch) {
+  // Each page of each request goes in once, quads refer to it by position.
+  std::map<std::pair<const Request*, int>, int> page_index;
+  std::vector<cv::Mat> pages;
+  std::vector<int> page_ids;
+  std::vector<int> angles;
+  BoxStore quads;
+  quads.Reserve(batch.size());
+  for (const auto& crop : batch) {
+    const Request& request = *crop.request;
+    int page = request.page_ids[crop.index];
+    auto inserted = page_index.emplace(std::make_pair(&request, page),
+                                       (int)pages.size());
+    if (inserted.second) {
+      pages.push_back(request.pages[page]);
+    }
+    page_ids.push_back(inserted.first->second);
+    angles.push_back(request.angles[crop.index]);
+    quads.Add(request.quads[crop.index]);
+  }
+
+  auto results = recognizer.PredictQuads(pages, page_ids, quads, angles);
+  // A failed batch leaves its quads with empty results, as PredictQuads
+  // does for a failed call.
+  for (size_t k = 0; k < batch.size(); ++k) {
+    Request& request = *batch[k].request;
+    if (k < results.size()) {
+      request.results[batch[k].index] = std::move(results[k]);
+    }
+    if (request.remaining.fetch_sub(1) == 1) {
+      request.promise.set_value(std::move(request.results));
+    }
+  }
+}
+
+std::string RecognitionService::SharedKey(const std::string& model_dir,
+                                          const TextRecPredictorParams& params,
+                                          const Options& options) {
+  std::ostringstream key;
+  key << model_dir << '\n'
+      << params.device << ' ' << params.precision << ' '
+      << params.enable_mkldnn << ' ' << params.batch_size << ' '
+      << params.lang << ' ' << params.ocr_version << ' '
+      << params.pipeline_depth << ' ' << params.pipeline_threads << ' '
+      << params.width_bucket_step << ' ' << params.parallel_postprocess << ' '
+      << params.cache_capacity << ' ' << params.cache_shards << ' '
+      << params.infer_backend << ' ' << params.replay_dir << '\n';
+  for (int width : params.width_bucket_list) {
+    key << width << ' ';
+  }
+  key << '\n';
+  // Sorted, so equal configs give equal keys.
+  std::map<std::string, std::string> config(params.config.begin(),
+                                            params.config.end());
+  for (const auto& item : config) {
+    key << item.first << '=' << item.second << '\n';
+  }
+  key << options.contexts << ' ' << options.max_wait_us << ' '
+      << options.max_batch << ' ' << options.width_budget << ' '
+      << options.max_padding;
+  return key.str();
+}
+
+std::shared_ptr<RecognitionService> RecognitionService::Shared(
+    const std::string& model_dir, const TextRecPredictorParams& params,
+    const Options& options) {
+  std::lock_guard<std::mutex> lock(shared_mutex_);
+  auto& service = shared_services_[SharedKey(model_dir, params, options)];
+  auto instance = service.lock();
+  if (instance == nullptr) {
+    instance = std::make_shared<RecognitionService>(model_dir, params,
+                                                    options);
+    service = instance;
+  }
+  return instance;
+}
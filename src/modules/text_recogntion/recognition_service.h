@@ -0,0 +1,143 @@
+// Copyright (c) 2025 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "predictor.h"
+
+// What RecognitionService needs of a recognizer. The service wraps
+// TextRecPredictor in one; benchmarks pass their own.
+class QuadRecognizer {
+ public:
+  virtual ~QuadRecognizer() = default;
+  virtual int SlotWidth(const BoxView& quad) const = 0;
+  // As TextRecPredictor::PredictQuads, for a batch the service planned.
+  virtual std::vector<TextRecPredictorResult> PredictQuads(
+      const std::vector<cv::Mat>& pages, const std::vector<int>& page_ids,
+      const BoxStore& quads, const std::vector<int>& angles) = 0;
+};
+
+// Recognizes quads for many callers on a few shared recognizers. Callers
+// submit the quads of their pages and wait on a future; a batcher thread
+// gathers the pending quads of all callers, sorted by width, into batches
+// planned by RecBatchPlanner and hands them to one worker thread per
+// recognizer. A batch is formed once enough quads are pending for a full
+// one or the oldest has waited `max_wait_us`, and only while a recognizer
+// is about to become free, so quads arriving meanwhile join it.
+class RecognitionService {
+ public:
+  struct Options {
+    int contexts = 1;
+    int max_wait_us = 2000;
+    int max_batch = 32;
+    int width_budget = 0;
+    float max_padding = 1.0f;
+  };
+
+  RecognitionService(const std::string& model_dir,
+                     const TextRecPredictorParams& params,
+                     const Options& options);
+  // One context per recognizer of `recognizers`, which must not be empty;
+  // options.contexts is ignored. Recognizers get batches planned by
+  // `options` and must not split them.
+  RecognitionService(std::vector<std::unique_ptr<QuadRecognizer>> recognizers,
+                     const Options& options);
+  // Finishes every submitted quad before returning.
+  ~RecognitionService();
+
+  RecognitionService(const RecognitionService&) = delete;
+  RecognitionService& operator=(const RecognitionService&) = delete;
+
+  // Results follow the order of `quads`, quads[i] being on
+  // pages[page_ids[i]], like TextRecPredictor::PredictQuads.
+  std::future<std::vector<TextRecPredictorResult>> Submit(
+      const std::vector<cv::Mat>& pages, const std::vector<int>& page_ids,
+      const BoxStore& quads, const std::vector<int>& angles);
+
+  // Process wide service for `model_dir`, `params` and `options`, made by
+  // the first caller and shared while any caller holds it. Callers with
+  // other settings get a service of their own. The batch_* params are
+  // ignored: `options` sets the batching and is part of the key. Only
+  // vis_font_dir is left out of the key, so the first caller's one wins.
+  static std::shared_ptr<RecognitionService> Shared(
+      const std::string& model_dir, const TextRecPredictorParams& params,
+      const Options& options);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Request {
+    std::vector<cv::Mat> pages;
+    std::vector<int> page_ids;
+    BoxStore quads;
+    std::vector<int> angles;
+    std::vector<TextRecPredictorResult> results;
+    std::atomic<size_t> remaining;
+    std::promise<std::vector<TextRecPredictorResult>> promise;
+  };
+  struct Crop {
+    std::shared_ptr<Request> request;
+    size_t index;
+    int slot_width;
+    Clock::time_point arrival;
+  };
+  using Batch = std::vector<Crop>;
+
+  void BatchLoop();
+  void WorkerLoop(size_t context);
+  void RunBatch(QuadRecognizer& recognizer, const Batch& batch);
+  // Whether the pending quads fill a batch already.
+  bool PendingFull() const;
+
+  static std::vector<std::unique_ptr<QuadRecognizer>> MakeRecognizers(
+      const std::string& model_dir, const TextRecPredictorParams& params,
+      const Options& options);
+  static std::string SharedKey(const std::string& model_dir,
+                               const TextRecPredictorParams& params,
+                               const Options& options);
+
+  Options options_;
+  RecBatchPlanner planner_;
+  std::vector<std::unique_ptr<QuadRecognizer>> recognizers_;
+
+  std::mutex mutex_;
+  // Wakes the batcher on new quads, workers on new batches and the batcher
+  // again when a worker takes one.
+  std::condition_variable pending_cv_;
+  std::condition_variable batch_cv_;
+  std::condition_variable taken_cv_;
+  std::deque<Crop> pending_;
+  int pending_max_slot_ = 0;
+  std::deque<Batch> batches_;
+  bool stop_batcher_ = false;
+  bool stop_workers_ = false;
+  std::thread batcher_;
+  std::vector<std::thread> workers_;
+
+  static std::mutex shared_mutex_;
+  static std::unordered_map<std::string, std::weak_ptr<RecognitionService>>
+      shared_services_;
+};
@@ -29,6 +29,13 @@ _DocPreprocessorPipeline::_DocPreprocessorPipeline(
     }
     config_ = YamlConfig(config_path.value());
   }
+  infer_backend_ = params.infer_backend;
+  replay_dir_ = params.replay_dir;
+  auto status_backend = SetInferBackend(config_);
+  if (!status_backend.ok()) {
+    INFOE("Invalid infer backend : %s", status_backend.ToString().c_str());
+    std::exit(-1);
+  }
   auto result_doc = config_.GetBool("use_doc_orientation_classify", true);
   if (!result_doc.ok()) {
     INFOE("use_doc_orientation_classify set fail : %s",
@@ -57,6 +64,8 @@ _DocPreprocessorPipeline::_DocPreprocessorPipeline(
     doc_ori_classify_params.precision = params_.precision;
     doc_ori_classify_params.enable_mkldnn = params_.enable_mkldnn;
     doc_ori_classify_params.batch_size = result_batch.value();
+    doc_ori_classify_params.infer_backend = infer_backend_;
+    doc_ori_classify_params.replay_dir = replay_dir_;
 
     auto result_model_name =
         config_.GetString("DocOrientationClassify.model_name");
@@ -97,6 +106,8 @@ _DocPreprocessorPipeline::_DocPreprocessorPipeline(
     doc_unwarping_params.precision = params_.precision;
     doc_unwarping_params.enable_mkldnn = params_.enable_mkldnn;
     doc_unwarping_params.batch_size = result_batch.value();
+    doc_unwarping_params.infer_backend = infer_backend_;
+    doc_unwarping_params.replay_dir = replay_dir_;
 
     auto result_model_name = config_.GetString("DocUnwarping.model_name");
     if (!result_model_name.ok()) {
@@ -333,39 +344,18 @@ absl::Status _DocPreprocessorPipeline::CheckModelSettingsVaild(
 
 std::vector<std::unique_ptr<BaseCVResult>> DocPreprocessorPipeline::Predict(
     const std::vector<std::string>& input) {
+  // Chunks of one image expand directories into the flat file list.
   batch_sampler_ptr_ =
       std::unique_ptr<BaseBatchSampler>(new ImageBatchSampler(1));
-  auto nomeaning = batch_sampler_ptr_->Apply(input);
-  int input_num = nomeaning.value().size();
-  int infer_batch_num = input_num / thread_num_;
-  auto status = batch_sampler_ptr_->SetBatchSize(infer_batch_num);
-  if (!status.ok()) {
-    INFOE("Set batch size fail : %s", status.ToString().c_str());
-  }
-  auto infer_batch_data =
-      batch_sampler_ptr_->SampleFromVectorToStringVector(input);
-  if (!infer_batch_data.ok()) {
+  auto sampled = batch_sampler_ptr_->SampleFromVectorToStringVector(input);
+  if (!sampled.ok()) {
     INFOE("Get infer batch data fail : %s",
-          infer_batch_data.status().ToString().c_str());
+          sampled.status().ToString().c_str());
+    return {};
   }
-  std::vector<std::unique_ptr<BaseCVResult>> results = {};
-  results.reserve(input_num);
-  for (auto& infer_data : infer_batch_data.value()) {
-    auto status =
-        AutoParallelSimpleInferencePipeline::PredictThread(infer_data);
-    if (!status.ok()) {
-      INFOE("Infer fail : %s", status.ToString().c_str());
-    }
-  }
-  for (int i = 0; i < infer_batch_data.value().size(); i++) {
-    auto infer_data_result = GetResult();
-    if (!infer_data_result.ok()) {
-      INFOE("Get infer result fail : %s",
-            infer_batch_data.status().ToString().c_str());
-    }
-    results.insert(results.end(),
-                   std::make_move_iterator(infer_data_result.value().begin()),
-                   std::make_move_iterator(infer_data_result.value().end()));
+  std::vector<std::string> files = {};
+  for (auto& chunk : sampled.value()) {
+    files.insert(files.end(), chunk.begin(), chunk.end());
   }
-  return results;
+  return PredictChunked(files);
 }
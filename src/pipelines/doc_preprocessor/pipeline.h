@@ -44,6 +44,9 @@ struct DocPreprocessorPipelineParams {
   std::unordered_map<std::string, std::string> config = {};
   bool use_doc_orientation_classify = false;
   bool use_doc_unwarping = false;
+  // Used unless the config sets Global.infer_backend, see BasePipeline.
+  std::string infer_backend = "";
+  std::string replay_dir = "";
 };
 
 class _DocPreprocessorPipeline : public BasePipeline {
@@ -14,6 +14,9 @@
 
 #include "pipeline.h"
 
+#include <algorithm>
+#include <numeric>
+
 #include "result.h"
 #include "src/utils/args.h"
 _OCRPipeline::_OCRPipeline(const std::string& model_dir,
@@ -28,6 +31,11 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
     config_ = YamlConfig(config_path.value());
   }
   OverrideConfig();
+  auto status_backend = SetInferBackend(config_);
+  if (!status_backend.ok()) {
+    INFOE("Invalid infer backend : %s", status_backend.ToString().c_str());
+    std::exit(-1);
+  }
   auto result_use_doc_preprocessor =
       config_.GetBool("use_doc_preprocessor", true);
   if (!result_use_doc_preprocessor.ok()) {
@@ -45,6 +53,8 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
     params.device = params_.device;
     params.precision = params_.precision;
     params.enable_mkldnn = params_.enable_mkldnn;
+    params.infer_backend = infer_backend_;
+    params.replay_dir = replay_dir_;
     params.use_doc_orientation_classify =
         config_.GetBool("DocPreprocessor.use_doc_orientation_classify", true)
             .value();  //** maybe no useless, config include
@@ -77,6 +87,8 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
     params.device = params_.device;
     params.precision = params_.precision;
     params.enable_mkldnn = params_.enable_mkldnn;
+    params.infer_backend = infer_backend_;
+    params.replay_dir = replay_dir_;
     auto result_batch_size =
         config_.GetInt("TextLineOrientation.batch_size", 1);
     if (!result_batch_size.ok()) {
@@ -85,6 +97,10 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
       return;
     }
     params.batch_size = result_batch_size.value();
+    params.pipeline_depth =
+        config_.GetInt("TextLineOrientation.pipeline_depth", 0).value();
+    params.pipeline_threads =
+        config_.GetInt("TextLineOrientation.pipeline_threads", 1).value();
 
     auto result_model_name =
         config_.GetString("TextLineOrientation.model_name");
@@ -109,6 +125,8 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
   params_det.device = params_.device;
   params_det.precision = params_.precision;
   params_det.enable_mkldnn = params_.enable_mkldnn;
+  params_det.infer_backend = infer_backend_;
+  params_det.replay_dir = replay_dir_;
   params_det.batch_size = config_.GetInt("TextDetection.batch_size", 1).value();
   if (text_type_ == "general") {
     params_det.limit_side_len =
@@ -122,7 +140,11 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
         config_.GetFloat("TextDetection.box_thresh", 0.6).value();
     params_det.unclip_ratio =
         config_.GetFloat("TextDetection.unclip_ratio", 2.0).value();
-    sort_boxes_ = ComponentsProcessor::SortQuadBoxes;
+    ReadingOrder reading_order(
+        config_.GetFloat("TextDetection.row_tolerance", 0.5).value());
+    order_boxes_ = [reading_order](const BoxStore& polys) {
+      return reading_order.Lines(polys);
+    };
     crop_by_polys_ = std::unique_ptr<CropByPolys>(new CropByPolys("quad"));
   } else if (text_type_ == "seal") {
     params_det.limit_side_len =
@@ -136,13 +158,49 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
         config_.GetFloat("TextDetection.box_thresh", 0.6).value();
     params_det.unclip_ratio =
         config_.GetFloat("TextDetection.unclip_ratio", 0.5).value();
-    sort_boxes_ = ComponentsProcessor::SortPolyBoxes;
+    order_boxes_ = ReadingOrder::ByTop;
     crop_by_polys_ = std::unique_ptr<CropByPolys>(new CropByPolys("poly"));
   } else {
     INFOE("Unsupported text type We %s", text_type.value().c_str());
     return;
   }
 
+  params_det.box_extractor =
+      config_.GetString("TextDetection.box_extractor", "contour").value();
+  if (params_det.box_extractor != "contour" &&
+      params_det.box_extractor != "ccl") {
+    INFOE("TextDetection.box_extractor must be contour or ccl, got %s",
+          params_det.box_extractor.c_str());
+    params_det.box_extractor = "contour";
+  }
+  params_det.score_engine =
+      config_.GetString("TextDetection.score_engine", "mask").value();
+  params_det.unclip_engine =
+      config_.GetString("TextDetection.unclip_engine", "clipper").value();
+  params_det.parallel_postprocess =
+      config_.GetBool("TextDetection.parallel_postprocess", false).value();
+  params_det.tile_size = config_.GetInt("TextDetection.tile_size", 0).value();
+  params_det.tile_overlap =
+      config_.GetInt("TextDetection.tile_overlap", 128).value();
+  params_det.tile_min_side =
+      config_.GetInt("TextDetection.tile_min_side", 4000).value();
+  params_det.tile_batch_size =
+      config_.GetInt("TextDetection.tile_batch_size", 4).value();
+  params_det.tile_merge_overlap =
+      config_.GetFloat("TextDetection.tile_merge_overlap", 0.5).value();
+  auto canvas_shapes =
+      config_.Data().find("SubModules.TextDetection.canvas_shapes");
+  if (canvas_shapes != config_.Data().end()) {
+    auto canvases = DetResizeForTest::ParseCanvases(
+        YamlConfig::SmartParseVector(canvas_shapes->second).vec_string);
+    if (!canvases.ok()) {
+      INFOE("Invalid TextDetection.canvas_shapes : %s",
+            canvases.status().ToString().c_str());
+    } else {
+      params_det.canvas_shapes = canvases.value();
+    }
+  }
+
   text_det_params_.text_det_limit_side_len = params_det.limit_side_len;
   text_det_params_.text_det_limit_type = params_det.limit_type;
   text_det_params_.text_det_max_side_limit = params_det.max_side_limit;
@@ -167,6 +225,33 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
   params_rec.device = params_.device;
   params_rec.precision = params_.precision;
   params_rec.enable_mkldnn = params_.enable_mkldnn;
+  params_rec.infer_backend = infer_backend_;
+  params_rec.replay_dir = replay_dir_;
+  params_rec.pipeline_depth =
+      config_.GetInt("TextRecognition.pipeline_depth", 0).value();
+  params_rec.pipeline_threads =
+      config_.GetInt("TextRecognition.pipeline_threads", 1).value();
+  params_rec.width_bucket_step =
+      config_.GetInt("TextRecognition.width_bucket_step", 0).value();
+  params_rec.parallel_postprocess =
+      config_.GetBool("TextRecognition.parallel_postprocess", false).value();
+  params_rec.cache_capacity =
+      config_.GetInt("TextRecognition.cache_capacity", 0).value();
+  params_rec.cache_shards =
+      config_.GetInt("TextRecognition.cache_shards", 16).value();
+  params_rec.batch_max_count =
+      config_.GetInt("TextRecognition.batch_max_count", 0).value();
+  params_rec.batch_width_budget =
+      config_.GetInt("TextRecognition.batch_width_budget", 0).value();
+  params_rec.batch_max_padding =
+      config_.GetFloat("TextRecognition.batch_max_padding", 1.0).value();
+  // Looked up exactly, the elements of a list share its key as a prefix.
+  auto width_bucket_list =
+      config_.Data().find("SubModules.TextRecognition.width_bucket_list");
+  if (width_bucket_list != config_.Data().end()) {
+    params_rec.width_bucket_list =
+        YamlConfig::SmartParseVector(width_bucket_list->second).vec_int;
+  }
 
   auto result_text_rec_model_name =
       config_.GetString("TextRecognition.model_name");
@@ -178,13 +263,34 @@ _OCRPipeline::_OCRPipeline(const std::string& model_dir,
   auto model_dir_text_rec =
       Utility::FindModelPath(model_dir, result_text_rec_model_name.value());
 
-  text_rec_model_ =
-      CreateModule<TextRecPredictor>(model_dir_text_rec.value(), params_rec);
   text_rec_score_thresh_ =
       config_.GetFloat("TextRecognition.score_thresh", 0.0).value();
+  use_fused_rec_crop_ =
+      config_.GetBool("TextRecognition.use_fused_crop", true).value();
+  // With service contexts the pipeline instances of the process recognize
+  // fused crops on that many shared recognizers instead of one each.
+  int service_contexts =
+      config_.GetInt("TextRecognition.service_contexts", 0).value();
+  if (service_contexts > 0 && use_fused_rec_crop_) {
+    RecognitionService::Options options;
+    options.contexts = service_contexts;
+    options.max_wait_us =
+        config_.GetInt("TextRecognition.service_max_wait_us", 2000).value();
+    options.max_batch = params_rec.batch_max_count > 0
+                            ? params_rec.batch_max_count
+                            : params_rec.batch_size;
+    options.width_budget = params_rec.batch_width_budget;
+    options.max_padding = params_rec.batch_max_padding;
+    rec_service_ = RecognitionService::Shared(model_dir_text_rec.value(),
+                                              params_rec, options);
+  } else {
+    text_rec_model_ = CreateModule<TextRecPredictor>(
+        model_dir_text_rec.value(), params_rec);
+  }
 
-  batch_sampler_ptr_ = std::unique_ptr<BaseBatchSampler>(
-      new ImageBatchSampler(1));  //** pipeline batch_size
+  // Pages detected together also share recognition batches.
+  batch_sampler_ptr_ = std::unique_ptr<BaseBatchSampler>(new ImageBatchSampler(
+      std::max(config_.GetInt("pipeline_batch_size", 1).value(), 1)));
 };
 
 absl::StatusOr<std::vector<cv::Mat>> _OCRPipeline::RotateImage(
@@ -274,10 +380,10 @@ std::vector<std::unique_ptr<BaseCVResult>> _OCRPipeline::Predict(
     std::vector<TextDetPredictorResult> det_results =
         static_cast<TextDetPredictor*>(text_det_model_.get())
             ->PredictorResult();
-    std::vector<std::vector<std::vector<cv::Point2f>>> dt_polys_list = {};
+    std::vector<BoxStore> dt_polys_list = {};
     for (auto& item : det_results) {
-      auto sort_item = sort_boxes_(item.dt_polys);
-      dt_polys_list.push_back(sort_item);
+      dt_polys_list.push_back(
+          item.dt_polys.Permute(order_boxes_(item.dt_polys)));
     }
 
     std::vector<int> indices = {};
@@ -300,19 +406,46 @@ std::vector<std::unique_ptr<BaseCVResult>> _OCRPipeline::Predict(
     if (!indices.empty()) {
       std::vector<cv::Mat> all_subs_of_imgs = {};
       std::vector<cv::Mat> all_subs_of_imgs_copy = {};
+      BoxStore all_quads;
       std::vector<int> chunk_indices(1, 0);
+      // The fused path only needs crops for the text line classifier.
+      bool need_crops = !use_fused_rec_crop_ ||
+                        model_settings["use_textline_orientation"];
       for (auto& idx : indices) {
-        auto result_all_subs_of_img = (*crop_by_polys_)(
-            doc_preprocessor_pipeline_images[idx], dt_polys_list[idx]);
-        if (!result_all_subs_of_img.ok()) {
-          INFOE("Split image fail : ",
-                result_all_subs_of_img.status().ToString().c_str());
+        // A page whose boxes cannot be cropped gets no crops and keeps
+        // empty results.
+        absl::StatusOr<BoxStore> result_quads = BoxStore();
+        if (use_fused_rec_crop_) {
+          result_quads = crop_by_polys_->CropQuads(dt_polys_list[idx]);
+          if (!result_quads.ok()) {
+            INFOE("Get crop quads fail : %s",
+                  result_quads.status().ToString().c_str());
+            chunk_indices.emplace_back(chunk_indices.back());
+            continue;
+          }
+        }
+        absl::StatusOr<std::vector<cv::Mat>> result_all_subs_of_img =
+            std::vector<cv::Mat>();
+        if (need_crops) {
+          result_all_subs_of_img = (*crop_by_polys_)(
+              doc_preprocessor_pipeline_images[idx], dt_polys_list[idx]);
+          if (!result_all_subs_of_img.ok()) {
+            INFOE("Split image fail : %s",
+                  result_all_subs_of_img.status().ToString().c_str());
+            chunk_indices.emplace_back(chunk_indices.back());
+            continue;
+          }
+        }
+        for (const auto& quad : result_quads.value()) {
+          all_quads.Add(quad);
         }
         all_subs_of_imgs.insert(all_subs_of_imgs.end(),
                                 result_all_subs_of_img.value().begin(),
                                 result_all_subs_of_img.value().end());
-        chunk_indices.emplace_back(chunk_indices.back() +
-                                   result_all_subs_of_img.value().size());
+        chunk_indices.emplace_back(
+            chunk_indices.back() +
+            (need_crops ? result_all_subs_of_img.value().size()
+                        : result_quads.value().size()));
       }
       for (auto& item : all_subs_of_imgs) {
         all_subs_of_imgs_copy.push_back(item.clone());
@@ -326,64 +459,95 @@ std::vector<std::unique_ptr<BaseCVResult>> _OCRPipeline::Predict(
         for (auto& result_angle : textline_orientation_model_results) {
           angles.push_back(result_angle.class_ids[0]);
         }
-        auto result_all_subs_of_imgs = RotateImage(all_subs_of_imgs, angles);
-        if (!result_all_subs_of_imgs.ok()) {
-          INFOE("Rotate images fail : %s",
-                result_all_subs_of_imgs.status().ToString().c_str());
+        if (!use_fused_rec_crop_) {
+          auto result_all_subs_of_imgs =
+              RotateImage(all_subs_of_imgs, angles);
+          if (!result_all_subs_of_imgs.ok()) {
+            INFOE("Rotate images fail : %s",
+                  result_all_subs_of_imgs.status().ToString().c_str());
+          }
+          all_subs_of_imgs = result_all_subs_of_imgs.value();
         }
-        all_subs_of_imgs = result_all_subs_of_imgs.value();
       } else {
-        angles = std::vector<int>(all_subs_of_imgs.size(), -1);
+        angles = std::vector<int>(chunk_indices.back(), -1);
       }
       for (int l = 0; l < indices.size(); l++) {
         for (int m = chunk_indices[l]; m < chunk_indices[l + 1]; m++) {
           results[indices[l]].textline_orientation_angles.push_back(angles[m]);
         }
       }
+      // Crops of every page in the batch are sorted by width together, so
+      // pages with few lines still fill whole recognition batches.
+      int crop_count = chunk_indices.back();
+      std::vector<int> crop_pages(crop_count);
+      std::vector<float> crop_ratios(crop_count);
       for (int l = 0; l < indices.size(); l++) {
-        std::vector<cv::Mat> all_subs_of_img = {};
         for (int m = chunk_indices[l]; m < chunk_indices[l + 1]; m++) {
-          all_subs_of_img.push_back(all_subs_of_imgs[m]);
+          crop_pages[m] = l;
+          if (use_fused_rec_crop_) {
+            crop_ratios[m] = OCRQuadToTensor::CropRatio(all_quads[m]);
+          } else {
+            crop_ratios[m] = (float)all_subs_of_imgs[m].size[1] /
+                             (float)all_subs_of_imgs[m].size[0];
+          }
         }
-        std::vector<std::pair<std::pair<int, float>, TextRecPredictorResult>>
-            sub_img_info_list = {};
-
-        for (int m = 0; m < all_subs_of_img.size(); m++) {
-          int sub_img_id = m;
-          float sub_img_ratio = (float)all_subs_of_img[m].size[1] /
-                                (float)all_subs_of_img[m].size[0];
-          TextRecPredictorResult result;
-          sub_img_info_list.push_back({{sub_img_id, sub_img_ratio}, result});
+      }
+      std::vector<int> sorted_crops(crop_count);
+      std::iota(sorted_crops.begin(), sorted_crops.end(), 0);
+      std::stable_sort(sorted_crops.begin(), sorted_crops.end(),
+                       [&crop_ratios](int a, int b) {
+                         return crop_ratios[a] < crop_ratios[b];
+                       });
+      std::vector<TextRecPredictorResult> text_rec_model_results = {};
+      if (use_fused_rec_crop_) {
+        std::vector<cv::Mat> pages = {};
+        for (auto& idx : indices) {
+          pages.push_back(doc_preprocessor_pipeline_images[idx]);
         }
-        std::vector<std::pair<int, float>> sorted_subs_info = {};
-        for (auto& item : sub_img_info_list) {
-          sorted_subs_info.push_back(item.first);
+        BoxStore sorted_quads;
+        sorted_quads.Reserve(crop_count);
+        std::vector<int> sorted_pages = {};
+        std::vector<int> sorted_angles = {};
+        for (int m : sorted_crops) {
+          sorted_quads.Add(all_quads[m]);
+          sorted_pages.push_back(crop_pages[m]);
+          sorted_angles.push_back(angles[m]);
         }
-        std::sort(
-            sorted_subs_info.begin(), sorted_subs_info.end(),
-            [](const std::pair<int, float>& a, const std::pair<int, float>& b) {
-              return a.second < b.second;
-            });
-        std::vector<cv::Mat> sorted_subs_of_img = {};
-        for (auto& item : sorted_subs_info) {
-          sorted_subs_of_img.push_back(all_subs_of_img[item.first]);
+        if (rec_service_ != nullptr) {
+          text_rec_model_results =
+              rec_service_
+                  ->Submit(pages, sorted_pages, sorted_quads, sorted_angles)
+                  .get();
+        } else {
+          text_rec_model_results =
+              static_cast<TextRecPredictor*>(text_rec_model_.get())
+                  ->PredictQuads(pages, sorted_pages, sorted_quads,
+                                 sorted_angles);
+        }
+      } else {
+        std::vector<cv::Mat> sorted_subs_of_imgs = {};
+        for (int m : sorted_crops) {
+          sorted_subs_of_imgs.push_back(all_subs_of_imgs[m]);
         }
-        text_rec_model_->Predict(sorted_subs_of_img);
-        // cv::imwrite("num_1,.jpg", sorted_subs_of_img[0]);
-        auto text_rec_model_results =
+        text_rec_model_->Predict(sorted_subs_of_imgs);
+        text_rec_model_results =
             static_cast<TextRecPredictor*>(text_rec_model_.get())
                 ->PredictorResult();
-        for (int m = 0; m < text_rec_model_results.size(); m++) {
-          int sub_img_id = sorted_subs_info[m].first;
-          sub_img_info_list[sub_img_id].second = text_rec_model_results[m];
-        }
-        for (int sno = 0; sno < sub_img_info_list.size(); sno++) {
-          auto rec_res = sub_img_info_list[sno].second;
+      }
+      std::vector<TextRecPredictorResult> crop_results(crop_count);
+      for (int k = 0; k < text_rec_model_results.size(); k++) {
+        crop_results[sorted_crops[k]] = std::move(text_rec_model_results[k]);
+      }
+      for (int l = 0; l < indices.size(); l++) {
+        OCRPipelineResult& result = results[indices[l]];
+        const BoxStore& polys = dt_polys_list[indices[l]];
+        for (int m = chunk_indices[l]; m < chunk_indices[l + 1]; m++) {
+          const auto& rec_res = crop_results[m];
           if (rec_res.rec_score >= text_rec_score_thresh_) {
-            results[l].rec_texts.push_back(rec_res.rec_text);
-            results[l].rec_scores.push_back(rec_res.rec_score);
-            results[l].rec_polys.push_back(dt_polys_list[l][sno]);
-            results[l].vis_fonts = rec_res.vis_font;
+            result.rec_texts.push_back(rec_res.rec_text);
+            result.rec_scores.push_back(rec_res.rec_score);
+            result.rec_polys.Add(polys[m - chunk_indices[l]]);
+            result.vis_fonts = rec_res.vis_font;
           }
         }
       }
@@ -402,41 +566,20 @@ std::vector<std::unique_ptr<BaseCVResult>> _OCRPipeline::Predict(
 
 std::vector<std::unique_ptr<BaseCVResult>> OCRPipeline::Predict(
     const std::vector<std::string>& input) {
+  // Chunks of one image expand directories into the flat file list.
   batch_sampler_ptr_ =
       std::unique_ptr<BaseBatchSampler>(new ImageBatchSampler(1));
-  auto nomeaning = batch_sampler_ptr_->Apply(input);
-  int input_num = nomeaning.value().size();
-  int infer_batch_num = input_num / thread_num_;
-  auto status = batch_sampler_ptr_->SetBatchSize(infer_batch_num);
-  if (!status.ok()) {
-    INFOE("Set batch size fail : %s", status.ToString().c_str());
-  }
-  auto infer_batch_data =
-      batch_sampler_ptr_->SampleFromVectorToStringVector(input);
-  if (!infer_batch_data.ok()) {
+  auto sampled = batch_sampler_ptr_->SampleFromVectorToStringVector(input);
+  if (!sampled.ok()) {
     INFOE("Get infer batch data fail : %s",
-          infer_batch_data.status().ToString().c_str());
+          sampled.status().ToString().c_str());
+    return {};
   }
-  std::vector<std::unique_ptr<BaseCVResult>> results = {};
-  results.reserve(input_num);
-  for (auto& infer_data : infer_batch_data.value()) {
-    auto status =
-        AutoParallelSimpleInferencePipeline::PredictThread(infer_data);
-    if (!status.ok()) {
-      INFOE("Infer fail : %s", status.ToString().c_str());
-    }
+  std::vector<std::string> files = {};
+  for (auto& chunk : sampled.value()) {
+    files.insert(files.end(), chunk.begin(), chunk.end());
   }
-  for (int i = 0; i < infer_batch_data.value().size(); i++) {
-    auto infer_data_result = GetResult();
-    if (!infer_data_result.ok()) {
-      INFOE("Get infer result fail : %s",
-            infer_batch_data.status().ToString().c_str());
-    }
-    results.insert(results.end(),
-                   std::make_move_iterator(infer_data_result.value().begin()),
-                   std::make_move_iterator(infer_data_result.value().end()));
-  }
-  return results;
+  return PredictChunked(files, Instance(0).BatchSize());
 }
 
 
@@ -585,6 +728,12 @@ void _OCRPipeline::OverrideConfig(){
       data[key]= FLAGS_use_doc_unwarping;
     }
   }    
+  if(!FLAGS_infer_backend.empty()){
+    data["Global.infer_backend"] = FLAGS_infer_backend;
+  }
+  if(!FLAGS_replay_dir.empty()){
+    data["Global.replay_dir"] = FLAGS_replay_dir;
+  }
   if(!FLAGS_use_textline_orientation.empty()){
     auto it = config_.FindKey("use_textline_orientation");
     if(!it.ok()){
@@ -27,6 +27,7 @@
 #include "src/modules/image_classification/predictor.h"
 #include "src/modules/text_detection/predictor.h"
 #include "src/modules/text_recogntion/predictor.h"
+#include "src/modules/text_recogntion/recognition_service.h"
 #include "src/pipelines/doc_preprocessor/pipeline.h"
 #include "src/utils/ilogger.h"
 
@@ -42,7 +43,7 @@ struct TextDetParams {
 struct OCRPipelineResult {
   std::string input_path = "";
   DocPreprocessorPipelineResult doc_preprocessor_res;
-  std::vector<std::vector<cv::Point2f>> dt_polys = {};
+  BoxStore dt_polys;
   std::unordered_map<std::string, bool> model_settings = {};
   TextDetParams text_det_params;
   std::string text_type = "";
@@ -50,7 +51,7 @@ struct OCRPipelineResult {
   std::vector<std::string> rec_texts = {};
   std::vector<float> rec_scores = {};
   std::vector<int> textline_orientation_angles = {};
-  std::vector<std::vector<cv::Point2f>> rec_polys = {};
+  BoxStore rec_polys;
   std::vector<std::array<float, 4>> rec_boxes = {};
   std::string vis_fonts = "";
 };
@@ -96,6 +97,8 @@ class _OCRPipeline : public BasePipeline {
 
   std::unordered_map<std::string, bool> GetModelSettings() const;
   TextDetParams GetTextDetParams() const { return text_det_params_; };
+  // Pages detected and recognized together, pipeline_batch_size.
+  int BatchSize() const { return batch_sampler_ptr_->BatchSize(); };
 
   void OverrideConfig();
 
@@ -111,12 +114,13 @@ class _OCRPipeline : public BasePipeline {
   bool use_textline_orientation_ = false;
   std::unique_ptr<BasePredictor> textline_orientation_model_;
   std::unique_ptr<BasePredictor> text_det_model_;
+  // Null while rec_service_ recognizes for this instance.
   std::unique_ptr<BasePredictor> text_rec_model_;
+  std::shared_ptr<RecognitionService> rec_service_;
   std::unique_ptr<CropByPolys> crop_by_polys_;
-  std::function<std::vector<std::vector<cv::Point2f>>(
-      const std::vector<std::vector<cv::Point2f>>&)>
-      sort_boxes_;
+  std::function<std::vector<int>(const BoxStore&)> order_boxes_;
   float text_rec_score_thresh_ = 0.0;
+  bool use_fused_rec_crop_ = true;
   std::string text_type_;
   TextDetParams text_det_params_;
 };
@@ -28,8 +28,7 @@ void OCRResult::SaveToImg(const std::string& save_path) {
   cv::Mat image = pipeline_result_.doc_preprocessor_res.output_image;
   auto texts = pipeline_result_.rec_texts;
   std::vector<std::vector<cv::Point>> boxes;
-  std::vector<std::vector<cv::Point2f>> boxes_float =
-      pipeline_result_.rec_polys;
+  const BoxStore& boxes_float = pipeline_result_.rec_polys;
   for (const auto& floatPolygon : pipeline_result_.rec_polys) {
     std::vector<cv::Point> intPolygon;
     for (const auto& point : floatPolygon) {
@@ -56,7 +55,7 @@ void OCRResult::SaveToImg(const std::string& save_path) {
 
   for (size_t i = 0; i < boxes.size(); ++i) {
     auto& box = boxes[i];
-    const auto& box_float = boxes_float[i];
+    BoxView box_float = boxes_float[i];
     const auto& text = texts[i];
 
     cv::Scalar color(dis(gen), dis(gen), dis(gen));
@@ -82,8 +81,9 @@ void OCRResult::SaveToImg(const std::string& save_path) {
       cv::fillPoly(img_left, std::vector<std::vector<cv::Point>>{box}, color);
     }
 #ifdef USE_FREETYPE
-    cv::Mat img_right_text = DrawBoxTextFine(cv::Size(w, h), box_float, text,
-                                             pipeline_result_.vis_fonts);
+    cv::Mat img_right_text =
+        DrawBoxTextFine(cv::Size(w, h), box_float.ToVector(), text,
+                        pipeline_result_.vis_fonts);
     cv::polylines(img_right_text, box, true, color, 1);
     cv::bitwise_and(img_right, img_right_text, img_right);
 #endif
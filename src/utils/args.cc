@@ -49,6 +49,8 @@ DEFINE_string(mkldnn_cache_capacity,"10","MKL-DNN cache capacity.");
 DEFINE_string(cpu_threads,"8","Number of threads used for paddlepaddle inference on CPU.");
 DEFINE_string(threads,"1","Number of threads used for pipeline instance inference on CPU.");
 DEFINE_string(paddlex_config,"","Path to the PaddleX pipeline configuration file.");
+DEFINE_string(infer_backend,"","Inference backend: paddle, record or replay.");
+DEFINE_string(replay_dir,"","Directory the record and replay backends use.");
 
 
 
@@ -51,6 +51,8 @@ DECLARE_string(mkldnn_cache_capacity);
 DECLARE_string(cpu_threads);
 DECLARE_string(threads);
 DECLARE_string(paddlex_config);
+DECLARE_string(infer_backend);
+DECLARE_string(replay_dir);
 
 
 
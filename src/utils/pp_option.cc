@@ -20,6 +20,14 @@
 
 #include "absl/status/statusor.h"
 
+const std::vector<std::string> PaddlePredictorOption::SUPPORT_INFER_BACKEND = {
+    "paddle", "record", "replay"};
+#ifdef PPOCR_WITHOUT_PADDLE
+const std::string PaddlePredictorOption::DEFAULT_INFER_BACKEND = "replay";
+#else
+const std::string PaddlePredictorOption::DEFAULT_INFER_BACKEND = "paddle";
+#endif
+
 const std::string &PaddlePredictorOption::RunMode() const { return run_mode_; }
 
 const std::string &PaddlePredictorOption::DeviceType() const {
@@ -42,6 +50,20 @@ int PaddlePredictorOption::MkldnnCacheCapacity() const {
   return mkldnn_cache_capacity_;
 }
 
+bool PaddlePredictorOption::EnableZeroCopy() const {
+  return enable_zero_copy_;
+}
+
+bool PaddlePredictorOption::SharePredictor() const { return share_predictor_; }
+
+const std::string &PaddlePredictorOption::InferBackend() const {
+  return infer_backend_;
+}
+
+const std::string &PaddlePredictorOption::ReplayDir() const {
+  return replay_dir_;
+}
+
 const std::vector<std::string> &PaddlePredictorOption::GetSupportRunMode()
     const {
   return SUPPORT_RUN_MODE;
@@ -114,6 +136,36 @@ absl::Status PaddlePredictorOption::SetMkldnnCacheCapacity(int capacity) {
   return absl::OkStatus();
 }
 
+void PaddlePredictorOption::SetEnableZeroCopy(bool enable_zero_copy) {
+  enable_zero_copy_ = enable_zero_copy;
+}
+
+void PaddlePredictorOption::SetSharePredictor(bool share_predictor) {
+  share_predictor_ = share_predictor;
+}
+
+absl::Status PaddlePredictorOption::SetInferBackend(
+    const std::string &infer_backend, const std::string &replay_dir) {
+  if (std::find(SUPPORT_INFER_BACKEND.begin(), SUPPORT_INFER_BACKEND.end(),
+                infer_backend) == SUPPORT_INFER_BACKEND.end()) {
+    return absl::InvalidArgumentError("Unsupported infer_backend: " +
+                                      infer_backend);
+  }
+#ifdef PPOCR_WITHOUT_PADDLE
+  if (infer_backend != "replay") {
+    return absl::InvalidArgumentError(
+        "Built without Paddle Inference, infer_backend must be replay");
+  }
+#endif
+  if (infer_backend != "paddle" && replay_dir.empty()) {
+    return absl::InvalidArgumentError("infer_backend " + infer_backend +
+                                      " needs a replay_dir");
+  }
+  infer_backend_ = infer_backend;
+  replay_dir_ = replay_dir;
+  return absl::OkStatus();
+}
+
 std::string PaddlePredictorOption::DebugString() const {
   std::ostringstream oss;
   oss << "run_mode: " << run_mode_ << ", "
@@ -128,6 +180,9 @@ std::string PaddlePredictorOption::DebugString() const {
   oss << "], "
       << "enable_new_ir: " << (enable_new_ir_ ? "true" : "false") << ", "
       << "enable_cinn: " << (enable_cinn_ ? "true" : "false") << ", "
-      << "mkldnn_cache_capacity: " << mkldnn_cache_capacity_;
+      << "mkldnn_cache_capacity: " << mkldnn_cache_capacity_ << ", "
+      << "enable_zero_copy: " << (enable_zero_copy_ ? "true" : "false") << ", "
+      << "share_predictor: " << (share_predictor_ ? "true" : "false") << ", "
+      << "infer_backend: " << infer_backend_;
   return oss.str();
 }
@@ -28,6 +28,12 @@ class PaddlePredictorOption {
 
   const std::vector<std::string> SUPPORT_DEVICE = {"gpu", "cpu"};
 
+  // "record" runs Paddle and saves the outputs to ReplayDir(), "replay" serves
+  // saved outputs without loading the model. Builds without Paddle Inference
+  // only support, and default to, "replay".
+  static const std::vector<std::string> SUPPORT_INFER_BACKEND;
+  static const std::string DEFAULT_INFER_BACKEND;
+
   const std::string& RunMode() const;
   const std::string& DeviceType() const;
   int DeviceId() const;
@@ -36,6 +42,10 @@ class PaddlePredictorOption {
   bool EnableNewIR() const;
   bool EnableCinn() const;
   int MkldnnCacheCapacity() const;
+  bool EnableZeroCopy() const;
+  bool SharePredictor() const;
+  const std::string& InferBackend() const;
+  const std::string& ReplayDir() const;
   const std::vector<std::string>& GetSupportRunMode() const;
   const std::vector<std::string>& GetSupportDevice() const;
   std::string DebugString() const;
@@ -48,6 +58,10 @@ class PaddlePredictorOption {
   void SetEnableNewIR(bool enable_new_ir);
   void SetEnableCinn(bool enable_cinn);
   absl::Status SetMkldnnCacheCapacity(int capacity);
+  void SetEnableZeroCopy(bool enable_zero_copy);
+  void SetSharePredictor(bool share_predictor);
+  absl::Status SetInferBackend(const std::string& infer_backend,
+                               const std::string& replay_dir = "");
 
  private:
   std::string run_mode_ = "paddle";
@@ -58,4 +72,8 @@ class PaddlePredictorOption {
   bool enable_new_ir_ = true;
   bool enable_cinn_ = false;
   int mkldnn_cache_capacity_ = 10;
+  bool enable_zero_copy_ = true;
+  bool share_predictor_ = true;
+  std::string infer_backend_ = DEFAULT_INFER_BACKEND;
+  std::string replay_dir_ = "";
 };
@@ -1,4 +1,6 @@
+#ifndef PPOCR_WITHOUT_PADDLE
 #include <paddle_inference_api.h>
+#endif
 
 #include <opencv2/opencv.hpp>
 